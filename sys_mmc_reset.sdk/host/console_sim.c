@@ -0,0 +1,203 @@
+/*
+ * Info   : Host model of the mdm_1 console (see console_sim.h)
+ */
+
+#include <string.h>
+#include "console_sim.h"
+#include "xuartlite_l.h"
+#include "mmc_sim.h"
+#include "upload.h"
+#include "crc32.h"
+
+#define FRAME_MAX (UPLOAD_MAX_LEN + 8)
+#define TX_FIFO   16 //bytes of the UART transmit FIFO
+
+static const u8 *file;
+static u32 file_len;
+static u32 nframes;   //data frames plus the end frame
+static u32 base;      //oldest frame not acknowledged
+static u32 next;      //next frame to be sent
+static u32 sent_max;  //frames sent at least once
+static u32 corrupt_every;
+static u32 byte_ns;
+static u32 resent;
+static int started;
+static int done;
+
+static u8  q[UPLOAD_WINDOW * FRAME_MAX]; //bytes on their way to the target
+static u32 q_head, q_len;
+
+static u8  rx_code = 0; //answer code waiting for its sequence byte
+
+static u8  *cap_buf = NULL; //capture mode buffer
+static u32 cap_max, cap_len;
+
+static u32 idle_polls = 0; //polls of an empty console in a row
+static u64 tx_end_ns  = 0; //model time when the transmit FIFO is empty
+
+#define GIVE_UP_POLLS 100000 //the PC has nothing more to send: inbyte() gives up
+
+static void put(u8 c)
+{
+	q[(q_head + q_len) % sizeof(q)] = c;
+	q_len++;
+}
+
+static void send_frame(u32 idx)
+{
+	u8  hdr[3], crc_buf[4], data[UPLOAD_MAX_LEN];
+	u32 len = 0, crc, i;
+
+	if (idx < nframes - 1) {
+		len = file_len - idx * UPLOAD_MAX_LEN;
+		if (len > UPLOAD_MAX_LEN) len = UPLOAD_MAX_LEN;
+		memcpy(data, file + idx * UPLOAD_MAX_LEN, len);
+	}
+	hdr[0] = idx;
+	hdr[1] = len >> 8;
+	hdr[2] = len;
+	crc = crc32_update(crc32_update(0, hdr, 3), data, len);
+	for (i = 0; i < 4; i++) crc_buf[i] = crc >> (24 - 8 * i);
+
+	if (idx >= sent_max) {
+		sent_max = idx + 1;
+		if (corrupt_every && idx % corrupt_every == corrupt_every - 1) crc_buf[3] ^= 0x01;
+	} else {
+		resent++;
+	}
+
+	put(UPLOAD_SOF);
+	for (i = 0; i < 3; i++) put(hdr[i]);
+	for (i = 0; i < len; i++) put(data[i]);
+	for (i = 0; i < 4; i++) put(crc_buf[i]);
+}
+
+/* frame index of sequence number SEQ, at or after BASE */
+static u32 frame_of(u8 seq)
+{
+	return base + (u8)(seq - (u8)base);
+}
+
+static void answer(u8 code, u8 seq)
+{
+	u32 idx = frame_of(seq);
+
+	if (code == UPLOAD_NAK) {
+		if (!started) {
+			started = 1;
+		} else if (idx < next) {
+			next = idx; //go back
+		}
+	} else if (idx < next) {
+		base = idx + 1;
+		if (idx == nframes - 1) done = 1;
+	}
+}
+
+void console_sim_upload(const u8 *data, u32 len, u32 every, u32 ns)
+{
+	file = data;
+	file_len = len;
+	nframes = (len + UPLOAD_MAX_LEN - 1) / UPLOAD_MAX_LEN + 1;
+	base = next = sent_max = resent = 0;
+	corrupt_every = every;
+	byte_ns = ns;
+	started = done = 0;
+	idle_polls = 0;
+	q_head = q_len = 0;
+	rx_code = 0;
+	cap_buf = NULL;
+	tx_end_ns = 0;
+}
+
+int console_sim_done(void)
+{
+	return done;
+}
+
+u32 console_sim_resent(void)
+{
+	return resent;
+}
+
+void console_sim_capture(u8 *buf, u32 max, u32 ns)
+{
+	cap_buf = buf;
+	cap_max = max;
+	cap_len = 0;
+	byte_ns = ns;
+	tx_end_ns = 0;
+}
+
+u32 console_sim_captured(void)
+{
+	return cap_len;
+}
+
+/* keep the window full */
+static void fill(void)
+{
+	while (started && !done && next < base + UPLOAD_WINDOW && next < nframes && q_len + FRAME_MAX <= sizeof(q)) {
+		send_frame(next++);
+	}
+}
+
+char inbyte(void)
+{
+	u8 c;
+
+	fill();
+	if (q_len == 0) {
+		done = -1; //nothing left to send: give up
+		return UPLOAD_CAN;
+	}
+
+	mmc_sim_idle(byte_ns);
+	c = q[q_head];
+	q_head = (q_head + 1) % sizeof(q);
+	q_len--;
+	return c;
+}
+
+int XUartLite_IsTransmitFull(u32 base_address)
+{
+	(void)base_address;
+	return tx_end_ns > mmc_sim_time_ns() + (TX_FIFO - 1) * (u64)byte_ns;
+}
+
+/* the PC sees the byte at once, the FIFO is busy with it for one byte time */
+void XUartLite_SendByte(u32 base_address, u8 c)
+{
+	(void)base_address;
+	if (tx_end_ns < mmc_sim_time_ns()) tx_end_ns = mmc_sim_time_ns();
+	tx_end_ns += byte_ns;
+
+	if (cap_buf) {
+		if (cap_len < cap_max) cap_buf[cap_len] = c;
+		cap_len++;
+	} else if (rx_code) {
+		answer(rx_code, c);
+		rx_code = 0;
+	} else if ((u8)c == UPLOAD_ACK || (u8)c == UPLOAD_NAK) {
+		rx_code = c;
+	} else if ((u8)c == UPLOAD_CAN) {
+		done = -1;
+	}
+}
+
+int XUartLite_IsReceiveEmpty(u32 base_address)
+{
+	(void)base_address;
+	fill();
+	if (q_len) {
+		idle_polls = 0;
+		return 0;
+	}
+	return ++idle_polls < GIVE_UP_POLLS;
+}
+
+u8 XUartLite_RecvByte(u32 base_address)
+{
+	(void)base_address;
+	return inbyte();
+}
@@ -0,0 +1,36 @@
+/*
+ * Info   : Host model of the mdm_1 console used by upload.c.
+ *          inbyte() and the UART calls used by console.c are connected to
+ *          a model of the PC side of the upload protocol: a go-back-N sender keeping up to UPLOAD_WINDOW
+ *          frames in flight. Every received byte advances the model time by
+ *          the configured byte time, the sent ones leave the 16 byte
+ *          transmit FIFO at that rate. In capture mode the bytes sent by the
+ *          target are stored instead (dump.c).
+ */
+
+#ifndef CONSOLE_SIM_H
+#define CONSOLE_SIM_H
+
+#include <xil_types.h>
+
+/* Prepare the PC to send LEN bytes of DATA
+ *  CORRUPT_EVERY: if not 0, the first transmission of every CORRUPT_EVERY-th frame is damaged
+ *  BYTE_NS      : time of one console byte
+ */
+void console_sim_upload(const u8 *data, u32 len, u32 corrupt_every, u32 byte_ns);
+
+/* returns: 1 when the end of file is acknowledged, -1 if the transfer was cancelled, 0 otherwise */
+int console_sim_done(void);
+
+/* returns: number of frames sent again after a NAK */
+u32 console_sim_resent(void);
+
+/* Store the next bytes sent by the target into BUF, up to MAX, instead of running the upload protocol
+ *  BYTE_NS: time of one console byte
+ */
+void console_sim_capture(u8 *buf, u32 max, u32 byte_ns);
+
+/* returns: number of bytes sent by the target since console_sim_capture(), stored or not */
+u32 console_sim_captured(void);
+
+#endif // CONSOLE_SIM_H
@@ -0,0 +1,268 @@
+/*
+ * Info   : Bridge between the mmc_* driver and the GHDL simulation, see
+ *          cosim.h. The functions called from VHDL (cosim_pkg.vhd) run on
+ *          the simulator thread, the driver only runs while the simulator
+ *          waits in cosim_request(), so the two never run at the same time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "cosim.h"
+#include "xiic_l.h"
+#include "xuartlite_l.h"
+#include "delay.h"
+#include "mmc_sim.h"
+
+/* requests, same values as in cosim_pkg.vhd */
+#define REQ_NONE 0
+#define REQ_RD   1
+#define REQ_WR   2
+#define REQ_IDLE 3
+#define REQ_END  4
+
+#define IDLE_MAX_NS 1000000000 //longest wait of one request (VHDL integer)
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+static pthread_t driver;
+static int started = 0;
+static int req = REQ_NONE; //posted by the driver, taken by the simulator
+static int busy = 0;       //the driver waits for the reply
+static u32 req_addr, req_data, rsp_data;
+static int status = 0;     //return value of cosim_main()
+
+static double now_ns = 0;  //simulation time of the last reply
+static double t0_ns = 0;   //simulation time of the last cosim_reset_stats()
+static u64 hold_ns = 0;    //stretch asked for by the last mmc_cosim_start()
+static cosim_stats stats;
+
+/********************** driver thread *************************/
+
+/* hand a request to the simulator and wait for its reply
+ *
+ *  returns: the reply data
+ */
+static u32 call(int kind, u32 addr, u32 data)
+{
+	pthread_mutex_lock(&lock);
+	req      = kind;
+	req_addr = addr;
+	req_data = data;
+	busy     = 1;
+	pthread_cond_broadcast(&cond);
+	while (busy) pthread_cond_wait(&cond, &lock);
+	data = rsp_data;
+	pthread_mutex_unlock(&lock);
+
+	return data;
+}
+
+static void *run(void *arg)
+{
+	(void)arg;
+	status = cosim_main() ? 1 : 0;
+
+	pthread_mutex_lock(&lock);
+	req = REQ_END; //no reply: the simulation ends
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+u32 XIic_ReadReg(UINTPTR BaseAddress, u32 RegOffset)
+{
+	(void)BaseAddress;
+	stats.axi_rd++;
+	return call(REQ_RD, RegOffset, 0);
+}
+
+void XIic_WriteReg(UINTPTR BaseAddress, u32 RegOffset, u32 RegisterValue)
+{
+	(void)BaseAddress;
+	stats.axi_wr++;
+	call(REQ_WR, RegOffset, RegisterValue);
+}
+
+static void idle(u64 ns)
+{
+	u32 k;
+
+	for (; ns; ns -= k) {
+		k = (ns > IDLE_MAX_NS) ? IDLE_MAX_NS : ns;
+		call(REQ_IDLE, 0, k);
+	}
+}
+
+void wait_us(u32 n)
+{
+	idle(1000ULL * n);
+}
+
+void wait_ms(u32 n)
+{
+	idle(1000000ULL * n);
+}
+
+void wait_s(u32 n)
+{
+	idle(1000000000ULL * n);
+}
+
+u32 time_now_us(void)
+{
+	return (u32)(now_ns / 1000);
+}
+
+void wait_until_us(u32 deadline)
+{
+	u32 now = time_now_us();
+
+	if (time_before(now, deadline)) idle(1000ULL * (deadline - now));
+}
+
+void time_advance_ns(u32 ns)
+{
+	(void)ns; //the RTL clock runs with the bus
+}
+
+int XUartLite_IsReceiveEmpty(u32 base_address)
+{
+	(void)base_address;
+	return 1;
+}
+
+u8 XUartLite_RecvByte(u32 base_address)
+{
+	(void)base_address;
+	return 0;
+}
+
+int XUartLite_IsTransmitFull(u32 base_address)
+{
+	(void)base_address;
+	return 0;
+}
+
+void XUartLite_SendByte(u32 base_address, u8 data)
+{
+	(void)base_address;
+	(void)data;
+}
+
+cosim_stats *cosim_get_stats(void)
+{
+	stats.sim_ns = (u64)(now_ns - t0_ns);
+	return &stats;
+}
+
+void cosim_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	t0_ns = now_ns;
+}
+
+/********************** simulator thread, AXI side *************************/
+
+int cosim_request(double t_ns)
+{
+	int kind;
+
+	pthread_mutex_lock(&lock);
+	now_ns = t_ns;
+	if (!started) {
+		started = 1;
+		if (pthread_create(&driver, NULL, run, NULL)) {
+			fprintf(stderr, "cosim_request()::ERROR::could not start the driver thread\n");
+			status = 1;
+			req = REQ_END;
+		}
+	}
+	while (req == REQ_NONE) pthread_cond_wait(&cond, &lock);
+	kind = req;
+	req = REQ_NONE;
+	pthread_mutex_unlock(&lock);
+
+	return kind;
+}
+
+int cosim_addr(void)
+{
+	return (int)req_addr;
+}
+
+int cosim_data(void)
+{
+	return (int)req_data;
+}
+
+int cosim_status(void)
+{
+	return status;
+}
+
+void cosim_reply(int data, int cycles, double t_ns)
+{
+	pthread_mutex_lock(&lock);
+	rsp_data = (u32)data;
+	now_ns   = t_ns;
+	stats.axi_cycles += cycles;
+	busy = 0;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+}
+
+void cosim_scl_rise(void)
+{
+	stats.scl_cycles++;
+}
+
+/********************** simulator thread, I2C side *************************/
+
+/* bring the MMC model to the simulation time T_NS: the wire time is counted
+ * by the RTL, the model only has to see the time pass for its commands
+ */
+static void sync(double t_ns)
+{
+	u64 t = (u64)t_ns;
+
+	if (t > mmc_sim_time_ns()) mmc_sim_idle(t - mmc_sim_time_ns());
+}
+
+int mmc_cosim_start(int addr_byte, double t_ns)
+{
+	u64 stretched = mmc_sim_get_stats()->stretch_ns;
+	int ack;
+
+	sync(t_ns);
+	ack = mmc_sim_start(addr_byte >> 1, addr_byte & 1);
+
+	/* a busy model moved its clock to the end of the command: hold SCL low until then */
+	hold_ns = mmc_sim_get_stats()->stretch_ns - stretched;
+	if (hold_ns > IDLE_MAX_NS) hold_ns = IDLE_MAX_NS;
+	stats.stretch_ns += hold_ns;
+	return ack;
+}
+
+int mmc_cosim_hold(void)
+{
+	return (int)hold_ns;
+}
+
+int mmc_cosim_write(int data, double t_ns)
+{
+	sync(t_ns);
+	return mmc_sim_write((u8)data);
+}
+
+int mmc_cosim_read(double t_ns)
+{
+	sync(t_ns);
+	return mmc_sim_read(1);
+}
+
+void mmc_cosim_stop(double t_ns)
+{
+	sync(t_ns);
+	mmc_sim_stop();
+}
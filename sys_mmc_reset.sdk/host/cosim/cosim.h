@@ -0,0 +1,36 @@
+/*
+ * Info   : Bridge between the mmc_* driver running on the host and the GHDL
+ *          simulation of the AXI IIC core (tb_cosim.vhd).
+ *          XIic_ReadReg/XIic_WriteReg become AXI-lite transactions in the
+ *          simulation and delay.h waits let the simulation time pass, so it
+ *          replaces iic_sim.c and delay_sim.c. The console has no PC
+ *          behind it: nothing is received and what is sent is dropped. The driver runs on its own
+ *          thread, cosim_main() is started by the first request of the
+ *          testbench and the simulation ends when it returns.
+ */
+
+#ifndef COSIM_H
+#define COSIM_H
+
+#include "xil_types.h"
+
+typedef struct {
+	u32 axi_rd;      //AXI-lite read transactions
+	u32 axi_wr;      //AXI-lite write transactions
+	u32 axi_cycles;  //s_axi_aclk cycles from VALID to the read data or write response
+	u32 scl_cycles;  //rising edges of SCL on the wire
+	u64 stretch_ns;  //time the MMC model held SCL low
+	u64 sim_ns;      //simulation time
+} cosim_stats;
+
+/* the co-simulated program, provided by the benchmark
+ *
+ * returns: 0 on success, 1 on failure (the simulation stops with an error)
+ */
+int cosim_main(void);
+
+/* counters since the last cosim_reset_stats() */
+cosim_stats *cosim_get_stats(void);
+void cosim_reset_stats(void);
+
+#endif // COSIM_H
@@ -0,0 +1,141 @@
+/*
+ * Info   : Co-simulation benchmark of the mmc_* layer against the RTL of the
+ *          AXI IIC core (iic_fifo.c backend). Runs single MMC operations at
+ *          the three bus speed profiles and reports for each one the exact
+ *          number of AXI-lite register accesses and s_axi_aclk cycles spent
+ *          in them, the SCL cycles on the wire and the simulation time.
+ *          The data read back through the core is checked against the MMC
+ *          model.
+ *
+ * Build  : needs GHDL (llvm or gcc backend) and the unisim library compiled
+ *          with GHDL's vendors/compile-xilinx-vivado.sh, in $UNISIM
+ *          IP=../../../sys_mmc_reset.srcs/sources_1/bd/design_1/ipshared/xilinx.com
+ *          V=hdl/src/vhdl
+ *          GF="--std=93c --ieee=synopsys -frelaxed -fexplicit -P$UNISIM"
+ *          ghdl -a $GF --work=lib_cdc_v1_0_2 $IP/lib_cdc_v1_0/$V/cdc_sync.vhd
+ *          ghdl -a $GF --work=interrupt_control_v3_1_4 $IP/interrupt_control_v3_1/$V/interrupt_control.vhd
+ *          ghdl -a $GF --work=axi_lite_ipif_v3_0_4 $IP/axi_lite_ipif_v3_0/$V/ipif_pkg.vhd \
+ *              $IP/axi_lite_ipif_v3_0/$V/pselect_f.vhd $IP/axi_lite_ipif_v3_0/$V/address_decoder.vhd \
+ *              $IP/axi_lite_ipif_v3_0/$V/slave_attachment.vhd $IP/axi_lite_ipif_v3_0/$V/axi_lite_ipif.vhd
+ *          ghdl -a $GF --work=axi_iic_v2_0_12 $(for f in iic_pkg upcnt_n shift8 debounce filter srl_fifo \
+ *              soft_reset reg_interface iic_control dynamic_master axi_ipif_ssp1 iic axi_iic; \
+ *              do echo $IP/axi_iic_v2_0/$V/$f.vhd; done)
+ *          ghdl -a $GF cosim_pkg.vhd mmc_i2c_slave.vhd tb_cosim.vhd
+ *          gcc -c -O2 -DMMC_BUS_BACKEND=2 -I. -I.. -I../../sw/src cosim_bench.c cosim.c ../mmc_sim.c \
+ *              ../../sw/src/mmc.c ../../sw/src/mmc_bus.c ../../sw/src/iic_fifo.c \
+ *              ../../sw/src/crc32.c ../../sw/src/sched.c ../../sw/src/console.c
+ *          ghdl -e $GF $(for o in *.o; do echo -Wl,$o; done) -Wl,-lpthread tb_cosim
+ * Usage  : ./tb_cosim
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "cosim.h"
+#include "mmc.h"
+#include "mmc_bus.h"
+#include "mmc_sim.h"
+
+#if MMC_BUS_BACKEND != MMC_BUS_FIFO
+#error the co-simulation drives the core registers: build with -DMMC_BUS_BACKEND=2
+#endif
+
+#define FLASH_ADR 0x20000 //flash page read by the benchmark
+
+static u8 page[MMC_FLASH_BUF_LEN];
+
+static int op_send32(void)
+{
+	return mmc_send32(MMC_DATA_WREG, 0x1234) != 4;
+}
+
+static int op_cmd_regs(void)
+{
+	u8 regs[20];
+
+	return mmc_get_cmd_regs(regs) != 20;
+}
+
+static int op_fread(void)
+{
+	mmc_set_addr(FLASH_ADR);
+	return (mmc_run_cmd(MMC_CMD_FREAD) & 0xFFFF) != 0;
+}
+
+static int op_get_buffer(void)
+{
+	memset(page, 0, sizeof(page));
+	if (mmc_get_buffer(page, MMC_FLASH_BUF_LEN) != MMC_FLASH_BUF_LEN) return 1;
+	if (memcmp(page, mmc_sim_flash() + FLASH_ADR, MMC_FLASH_BUF_LEN)) {
+		printf("op_get_buffer()::ERROR::flash page read through the core does not match the model\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int op_set_buffer(void)
+{
+	return mmc_set_buffer(page, MMC_FLASH_BUF_LEN) != 2 * MMC_FLASH_BUF_LEN; //counts the 4 bytes sent per 2 data bytes
+}
+
+static const struct {
+	const char *name;
+	int (*fn)(void);
+} ops[] = {
+	{"mmc_send32",             op_send32},
+	{"mmc_get_cmd_regs",       op_cmd_regs},
+	{"FREAD (set addr, poll)", op_fread},
+	{"mmc_get_buffer(256)",    op_get_buffer},
+	{"mmc_set_buffer(256)",    op_set_buffer},
+};
+
+/* run every operation at the bus speed SPEED and report its cost
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int speed_run(u8 speed)
+{
+	cosim_stats *st;
+	u32 i;
+
+	if (mmc_bus_set_speed(speed)) return 1;
+	mmc_shadow_invalidate();
+	printf("\n%u Hz\n", mmc_bus_get_scl_hz());
+	printf("  %-24s %6s %6s %8s %8s %10s %10s\n", "operation", "AXI rd", "AXI wr", "aclk", "SCL", "stretch us", "time us");
+
+	for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+		cosim_reset_stats();
+		if (ops[i].fn()) {
+			printf("speed_run()::ERROR::%s failed at %u Hz\n", ops[i].name, mmc_bus_get_scl_hz());
+			return 1;
+		}
+		st = cosim_get_stats();
+		printf("  %-24s %6u %6u %8u %8u %10.1f %10.1f\n", ops[i].name, st->axi_rd, st->axi_wr, st->axi_cycles,
+		       st->scl_cycles, st->stretch_ns / 1e3, st->sim_ns / 1e3);
+	}
+	return 0;
+}
+
+int cosim_main(void)
+{
+	u32 i, x = 0x12345678;
+	u8 *flash;
+
+	mmc_sim_init(1000000000); //the wire time comes from the RTL, the model keeps only its command times
+	mmc_sim_set_stretch(1);
+	flash = mmc_sim_flash();
+	for (i = 0; i < MMC_FLASH_BUF_LEN; i++) {
+		x = x * 1103515245 + 12345;
+		flash[FLASH_ADR + i] = x >> 16;
+	}
+
+	if (mmc_bus_init()) {
+		printf("cosim_main()::ERROR::mmc_bus_init() failed\n");
+		return 1;
+	}
+	printf("mmc_* on the AXI IIC RTL, s_axi_aclk 125 MHz");
+	for (i = 0; i < MMC_BUS_SPEED_COUNT; i++) {
+		if (speed_run(i)) return 1;
+	}
+	printf("\n");
+	return 0;
+}
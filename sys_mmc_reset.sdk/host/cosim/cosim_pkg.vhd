@@ -0,0 +1,118 @@
+--
+-- Info   : Foreign (VHPIDIRECT) entry points of the co-simulation bridge,
+--          implemented in cosim.c. The bodies below are never executed.
+--
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+package cosim_pkg is
+
+   -- requests of the driver, see cosim_request()
+   constant COSIM_RD   : integer := 1; -- AXI-lite read of cosim_addr
+   constant COSIM_WR   : integer := 2; -- AXI-lite write of cosim_data to cosim_addr
+   constant COSIM_IDLE : integer := 3; -- the CPU waits cosim_data ns
+   constant COSIM_END  : integer := 4; -- the driver returned cosim_status
+
+   -- simulation time in ns, without overflowing a 32-bit integer
+   impure function now_ns return real;
+
+   -- AXI side: blocks until the driver issues its next register access
+   function cosim_request(t_ns : real) return integer;
+   attribute foreign of cosim_request : function is "VHPIDIRECT cosim_request";
+   function cosim_addr return integer;
+   attribute foreign of cosim_addr : function is "VHPIDIRECT cosim_addr";
+   function cosim_data return integer;
+   attribute foreign of cosim_data : function is "VHPIDIRECT cosim_data";
+   function cosim_status return integer;
+   attribute foreign of cosim_status : function is "VHPIDIRECT cosim_status";
+   procedure cosim_reply(data : integer; cycles : integer; t_ns : real);
+   attribute foreign of cosim_reply : procedure is "VHPIDIRECT cosim_reply";
+   procedure cosim_scl_rise;
+   attribute foreign of cosim_scl_rise : procedure is "VHPIDIRECT cosim_scl_rise";
+
+   -- I2C side: byte level calls into the MMC model (mmc_sim.c)
+   function mmc_cosim_start(addr_byte : integer; t_ns : real) return integer;
+   attribute foreign of mmc_cosim_start : function is "VHPIDIRECT mmc_cosim_start";
+   function mmc_cosim_write(data : integer; t_ns : real) return integer;
+   attribute foreign of mmc_cosim_write : function is "VHPIDIRECT mmc_cosim_write";
+   function mmc_cosim_read(t_ns : real) return integer;
+   attribute foreign of mmc_cosim_read : function is "VHPIDIRECT mmc_cosim_read";
+   procedure mmc_cosim_stop(t_ns : real);
+   attribute foreign of mmc_cosim_stop : procedure is "VHPIDIRECT mmc_cosim_stop";
+   function mmc_cosim_hold return integer;
+   attribute foreign of mmc_cosim_hold : function is "VHPIDIRECT mmc_cosim_hold";
+
+end package cosim_pkg;
+
+package body cosim_pkg is
+
+   impure function now_ns return real is
+   begin
+      return real(now / 1 us) * 1000.0 + real((now mod 1 us) / 1 ps) / 1000.0;
+   end function now_ns;
+
+   function cosim_request(t_ns : real) return integer is
+   begin
+      assert false severity failure;
+      return 0;
+   end function cosim_request;
+
+   function cosim_addr return integer is
+   begin
+      assert false severity failure;
+      return 0;
+   end function cosim_addr;
+
+   function cosim_data return integer is
+   begin
+      assert false severity failure;
+      return 0;
+   end function cosim_data;
+
+   function cosim_status return integer is
+   begin
+      assert false severity failure;
+      return 0;
+   end function cosim_status;
+
+   procedure cosim_reply(data : integer; cycles : integer; t_ns : real) is
+   begin
+      assert false severity failure;
+   end procedure cosim_reply;
+
+   procedure cosim_scl_rise is
+   begin
+      assert false severity failure;
+   end procedure cosim_scl_rise;
+
+   function mmc_cosim_start(addr_byte : integer; t_ns : real) return integer is
+   begin
+      assert false severity failure;
+      return 0;
+   end function mmc_cosim_start;
+
+   function mmc_cosim_write(data : integer; t_ns : real) return integer is
+   begin
+      assert false severity failure;
+      return 0;
+   end function mmc_cosim_write;
+
+   function mmc_cosim_read(t_ns : real) return integer is
+   begin
+      assert false severity failure;
+      return 0;
+   end function mmc_cosim_read;
+
+   procedure mmc_cosim_stop(t_ns : real) is
+   begin
+      assert false severity failure;
+   end procedure mmc_cosim_stop;
+
+   function mmc_cosim_hold return integer is
+   begin
+      assert false severity failure;
+      return 0;
+   end function mmc_cosim_hold;
+
+end package body cosim_pkg;
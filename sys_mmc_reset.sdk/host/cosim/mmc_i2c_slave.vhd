@@ -0,0 +1,116 @@
+--
+-- Info   : Behavioral I2C slave of the GPAC3 MMC for the co-simulation.
+--          Decodes START/STOP and the bits on the wire and hands every byte
+--          to the MMC model (mmc_sim.c) through cosim.c. When the model is
+--          busy with a command it holds SCL low after acknowledging its
+--          address, like the MMC firmware does.
+--
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.cosim_pkg.all;
+
+entity mmc_i2c_slave is
+   port (
+      scl      : in  std_logic;  -- wire levels, '0' or '1'
+      sda      : in  std_logic;
+      scl_pull : out std_logic;  -- '0': hold SCL low
+      sda_pull : out std_logic   -- '0': drive SDA low
+   );
+end entity mmc_i2c_slave;
+
+architecture behav of mmc_i2c_slave is
+
+   signal stretch_req : boolean := false; -- toggles to start a stretch of stretch_for
+   signal stretch_for : time    := 0 ns;
+
+begin
+
+   bus_fsm : process (scl, sda)
+      type state_t is (IDLE, ADDR, WRITE, READ, NACKED);
+      variable state   : state_t := IDLE;
+      variable shreg   : std_logic_vector(7 downto 0) := (others => '1');
+      variable bits    : integer := 0;     -- rising SCL edges in the current byte, the 9th is the acknowledge
+      variable reading : boolean := false; -- the address byte asked for a read
+      variable hold    : integer;
+   begin
+      if sda'event and scl = '1' then
+         -- START (SDA falls) or STOP (SDA rises) while SCL is high
+         sda_pull <= '1';
+         if sda = '0' then
+            state := ADDR;
+         else
+            if state /= IDLE then
+               mmc_cosim_stop(now_ns);
+            end if;
+            state := IDLE;
+         end if;
+         bits := 0;
+
+      elsif scl'event and scl = '1' then
+         if bits < 8 then
+            shreg := shreg(6 downto 0) & sda;
+         elsif state = READ and sda = '1' then
+            state := NACKED; -- the master does not want more bytes
+         end if;
+         bits := bits + 1;
+
+      elsif scl'event and scl = '0' and state /= IDLE then
+         if bits = 8 then
+            -- the byte is complete: acknowledge it or release SDA for the master's acknowledge
+            case state is
+               when ADDR =>
+                  reading := shreg(0) = '1';
+                  if mmc_cosim_start(to_integer(unsigned(shreg)), now_ns) = 1 then
+                     sda_pull <= '0';
+                  else
+                     state := NACKED;
+                  end if;
+                  hold := mmc_cosim_hold;
+                  if hold > 0 then
+                     stretch_for <= hold * 1 ns;
+                     stretch_req <= not stretch_req;
+                  end if;
+               when WRITE =>
+                  if mmc_cosim_write(to_integer(unsigned(shreg)), now_ns) = 1 then
+                     sda_pull <= '0';
+                  else
+                     state := NACKED;
+                  end if;
+               when others =>
+                  sda_pull <= '1';
+            end case;
+
+         elsif bits = 9 then
+            -- end of the acknowledge: start the next byte
+            bits := 0;
+            if state = ADDR then
+               if reading then
+                  state := READ;
+               else
+                  state := WRITE;
+               end if;
+            end if;
+            if state = READ then
+               shreg := std_logic_vector(to_unsigned(mmc_cosim_read(now_ns), 8));
+               sda_pull <= shreg(7);
+            else
+               sda_pull <= '1';
+            end if;
+
+         elsif state = READ then
+            sda_pull <= shreg(7 - bits);
+         end if;
+      end if;
+   end process bus_fsm;
+
+   stretch : process
+   begin
+      scl_pull <= '1';
+      wait on stretch_req;
+      scl_pull <= '0';
+      wait for stretch_for;
+   end process stretch;
+
+end architecture behav;
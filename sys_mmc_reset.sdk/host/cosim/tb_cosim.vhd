@@ -0,0 +1,188 @@
+--
+-- Info   : Co-simulation top: the AXI IIC core of the board (axi_iic_v2_0,
+--          same generics as design_1) clocked at 125 MHz, an AXI-lite master
+--          that runs the register accesses of the mmc_* driver handed over by
+--          cosim.c, and the MMC I2C slave model on pulled-up SCL/SDA lines.
+--          The CPU takes no time between two accesses, only its waits
+--          (wait_us() and friends) let the simulation time pass.
+--
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library axi_iic_v2_0_12;
+
+use work.cosim_pkg.all;
+
+entity tb_cosim is
+end entity tb_cosim;
+
+architecture sim of tb_cosim is
+
+   constant ACLK_PERIOD : time := 8 ns; -- s_axi_aclk, 125 MHz
+
+   signal done    : boolean := false;
+   signal aclk    : std_logic := '0';
+   signal aresetn : std_logic := '0';
+
+   signal awaddr  : std_logic_vector(8 downto 0) := (others => '0');
+   signal awvalid : std_logic := '0';
+   signal awready : std_logic;
+   signal wdata   : std_logic_vector(31 downto 0) := (others => '0');
+   signal wvalid  : std_logic := '0';
+   signal wready  : std_logic;
+   signal bresp   : std_logic_vector(1 downto 0);
+   signal bvalid  : std_logic;
+   signal bready  : std_logic := '0';
+   signal araddr  : std_logic_vector(8 downto 0) := (others => '0');
+   signal arvalid : std_logic := '0';
+   signal arready : std_logic;
+   signal rdata   : std_logic_vector(31 downto 0);
+   signal rresp   : std_logic_vector(1 downto 0);
+   signal rvalid  : std_logic;
+   signal rready  : std_logic := '0';
+   signal irq     : std_logic;
+   signal gpo     : std_logic_vector(0 downto 0);
+
+   signal scl_o, scl_t, sda_o, sda_t : std_logic;
+   signal mmc_scl, mmc_sda           : std_logic; -- '0': the MMC pulls the line low
+   signal scl, sda                   : std_logic; -- the wires
+
+begin
+
+   aclk <= not aclk after ACLK_PERIOD / 2 when not done else '0';
+
+   -- open drain lines with pull-ups
+   scl <= '0' when (scl_t = '0' and scl_o = '0') or mmc_scl = '0' else '1';
+   sda <= '0' when (sda_t = '0' and sda_o = '0') or mmc_sda = '0' else '1';
+
+   dut : entity axi_iic_v2_0_12.axi_iic
+      generic map (
+         C_FAMILY             => "artix7",
+         C_S_AXI_ADDR_WIDTH   => 9,
+         C_S_AXI_DATA_WIDTH   => 32,
+         C_IIC_FREQ           => 100000,
+         C_TEN_BIT_ADR        => 0,
+         C_GPO_WIDTH          => 1,
+         C_S_AXI_ACLK_FREQ_HZ => 125000000,
+         C_SCL_INERTIAL_DELAY => 0,
+         C_SDA_INERTIAL_DELAY => 0,
+         C_SDA_LEVEL          => 1,
+         C_SMBUS_PMBUS_HOST   => 0,
+         C_DEFAULT_VALUE      => x"00"
+      )
+      port map (
+         s_axi_aclk    => aclk,
+         s_axi_aresetn => aresetn,
+         iic2intc_irpt => irq,
+         s_axi_awaddr  => awaddr,
+         s_axi_awvalid => awvalid,
+         s_axi_awready => awready,
+         s_axi_wdata   => wdata,
+         s_axi_wstrb   => "1111",
+         s_axi_wvalid  => wvalid,
+         s_axi_wready  => wready,
+         s_axi_bresp   => bresp,
+         s_axi_bvalid  => bvalid,
+         s_axi_bready  => bready,
+         s_axi_araddr  => araddr,
+         s_axi_arvalid => arvalid,
+         s_axi_arready => arready,
+         s_axi_rdata   => rdata,
+         s_axi_rresp   => rresp,
+         s_axi_rvalid  => rvalid,
+         s_axi_rready  => rready,
+         sda_i         => sda,
+         sda_o         => sda_o,
+         sda_t         => sda_t,
+         scl_i         => scl,
+         scl_o         => scl_o,
+         scl_t         => scl_t,
+         gpo           => gpo
+      );
+
+   mmc : entity work.mmc_i2c_slave
+      port map (
+         scl      => scl,
+         sda      => sda,
+         scl_pull => mmc_scl,
+         sda_pull => mmc_sda
+      );
+
+   scl_count : process (scl)
+   begin
+      if rising_edge(scl) then
+         cosim_scl_rise;
+      end if;
+   end process scl_count;
+
+   -- one AXI-lite transaction per request of the driver, timed in s_axi_aclk cycles
+   master : process
+      variable kind   : integer;
+      variable data   : integer;
+      variable cycles : integer;
+   begin
+      wait for 16 * ACLK_PERIOD;
+      wait until rising_edge(aclk);
+      aresetn <= '1';
+      wait until rising_edge(aclk);
+
+      loop
+         kind := cosim_request(now_ns);
+         exit when kind = COSIM_END;
+         data   := 0;
+         cycles := 0;
+
+         case kind is
+            when COSIM_RD =>
+               araddr  <= std_logic_vector(to_unsigned(cosim_addr, 9));
+               arvalid <= '1';
+               rready  <= '1';
+               loop
+                  wait until rising_edge(aclk);
+                  cycles := cycles + 1;
+                  if arready = '1' then
+                     arvalid <= '0';
+                  end if;
+                  exit when rvalid = '1';
+               end loop;
+               data   := to_integer(signed(rdata));
+               rready <= '0';
+
+            when COSIM_WR =>
+               awaddr  <= std_logic_vector(to_unsigned(cosim_addr, 9));
+               wdata   <= std_logic_vector(to_signed(cosim_data, 32));
+               awvalid <= '1';
+               wvalid  <= '1';
+               bready  <= '1';
+               loop
+                  wait until rising_edge(aclk);
+                  cycles := cycles + 1;
+                  if awready = '1' then
+                     awvalid <= '0';
+                  end if;
+                  if wready = '1' then
+                     wvalid <= '0';
+                  end if;
+                  exit when bvalid = '1';
+               end loop;
+               bready <= '0';
+
+            when COSIM_IDLE =>
+               wait for cosim_data * 1 ns;
+               wait until rising_edge(aclk);
+
+            when others =>
+               report "unknown co-simulation request" severity failure;
+         end case;
+
+         cosim_reply(data, cycles, now_ns);
+      end loop;
+
+      assert cosim_status = 0 report "co-simulation benchmark failed" severity failure;
+      done <= true;
+      wait;
+   end process master;
+
+end architecture sim;
@@ -0,0 +1,48 @@
+/*
+ * Info   : Host implementation of delay.h: waiting advances the model time
+ *          instead of spinning, so the MMC model sees the same pacing. The
+ *          timebase is the model clock, which already counts the bus time.
+ */
+
+#include "delay.h"
+#include "mmc_sim.h"
+#include "xiic.h"
+
+void wait_us(u32 n)
+{
+	mmc_sim_idle(1000ULL * n);
+}
+
+void wait_ms(u32 n)
+{
+	mmc_sim_idle(1000000ULL * n);
+}
+
+void wait_s(u32 n)
+{
+	mmc_sim_idle(1000000000ULL * n);
+}
+
+u32 time_now_us(void)
+{
+	return (u32)(mmc_sim_time_ns() / 1000);
+}
+
+void wait_until_us(u32 deadline)
+{
+	u32 now = time_now_us();
+
+	if (time_before(now, deadline)) mmc_sim_idle(1000ULL * (deadline - now) - mmc_sim_time_ns() % 1000);
+}
+
+/* the transactions already ran on the model: only their interrupts are due */
+void spin_us(u32 n)
+{
+	(void)n;
+	xiic_sim_interrupt();
+}
+
+void time_advance_ns(u32 ns)
+{
+	(void)ns; //the model clock already counts the bus time
+}
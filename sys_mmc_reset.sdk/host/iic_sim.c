@@ -0,0 +1,182 @@
+/*
+ * Info   : Register model of the AXI IIC core (dynamic controller mode only)
+ *          in front of the MMC model.
+ *
+ * The wire is infinitely fast compared to the CPU: TX FIFO entries are put
+ * on the bus as soon as they are written, while the RX FIFO is limited to
+ * its real depth and received bytes only arrive when the CPU makes room.
+ * Wire time is still accounted by mmc_sim.c, at the SCL rate given by the
+ * THIGH and TLOW registers once they are written.
+ *
+ * After an address or data NACK the core sends a STOP and stalls: the entries
+ * that were not sent and the ones written afterwards stay in the TX FIFO
+ * until the CPU resets it.
+ */
+
+#include <string.h>
+#include "xiic_l.h"
+#include "mmc_sim.h"
+
+#define FIFO_DEPTH 16
+#define AXI_HZ     125000000 //s_axi_aclk
+
+#define TIMING_THIGH 5 //index in TIMING[]
+#define TIMING_TLOW  6
+
+enum { IDLE, WRITING, WAIT_COUNT, READING, HELD, STALLED };
+
+static int state = IDLE;
+static u32 cr = 0;
+static u32 isr = 0;
+static u32 ier = 0;
+static u32 gie = 0;
+static u32 rfd = 0;
+static u32 gpo = 0;
+static u32 tx_count = 0; //entries stuck in the TX FIFO after a NACK
+static u32 timing[8];    //TSUSTA .. THDDAT, only THIGH and TLOW have an effect
+
+static u8  rx_fifo[FIFO_DEPTH];
+static u32 rx_head = 0;
+static u32 rx_count = 0;
+static u32 rx_left = 0;  //bytes still to be read from the slave
+static int rx_stop = 0;  //STOP after the last byte
+
+/* raise the interrupt status bits whose condition is true */
+static void update_isr(void)
+{
+	if (tx_count == 0)              isr |= XIIC_INTR_TX_EMPTY_MASK;
+	if (tx_count <= FIFO_DEPTH / 2) isr |= XIIC_INTR_TX_HALF_MASK;
+	if (rx_count >= rfd + 1) isr |= XIIC_INTR_RX_FULL_MASK;
+	if (state == IDLE || state == STALLED) isr |= XIIC_INTR_BNB_MASK;
+}
+
+static void end_of_read(void)
+{
+	if (rx_stop) {
+		mmc_sim_stop();
+		state = IDLE;
+	} else {
+		state = HELD;
+	}
+}
+
+/* move bytes from the slave into the RX FIFO while there is room */
+static void receive(void)
+{
+	while (state == READING && rx_left && rx_count < FIFO_DEPTH) {
+		rx_fifo[(rx_head + rx_count) % FIFO_DEPTH] = mmc_sim_read(rx_left > 1);
+		rx_count++;
+		if (--rx_left == 0) end_of_read();
+	}
+	update_isr();
+}
+
+static void reset(void)
+{
+	state = IDLE;
+	cr = isr = ier = gie = rfd = gpo = 0;
+	rx_head = rx_count = rx_left = tx_count = 0;
+	memset(timing, 0, sizeof(timing));
+}
+
+/* address or data NACK: STOP, then keep the FIFO until it is reset */
+static void stall(void)
+{
+	mmc_sim_stop();
+	state = STALLED;
+	isr |= XIIC_INTR_TX_ERROR_MASK;
+}
+
+static void tx_entry(u32 v)
+{
+	if (state == STALLED) {
+		if (tx_count < FIFO_DEPTH) tx_count++; //a full FIFO drops the write
+	} else if ((v & XIIC_TX_DYN_START_MASK) && state != WAIT_COUNT && state != READING) {
+		if (!mmc_sim_start((v >> 1) & 0x7F, v & 1)) {
+			stall();
+			update_isr();
+			return;
+		}
+		state = (v & 1) ? WAIT_COUNT : WRITING;
+	} else if (state == WAIT_COUNT) {
+		rx_left = v & 0xFF;
+		rx_stop = (v & XIIC_TX_DYN_STOP_MASK) != 0;
+		state = READING;
+		if (rx_left == 0) end_of_read();
+		receive();
+		return;
+	} else if (state == WRITING) {
+		if (!mmc_sim_write(v & 0xFF)) { //the core stops on a data NACK too
+			stall();
+		} else if (v & XIIC_TX_DYN_STOP_MASK) {
+			mmc_sim_stop();
+			state = IDLE;
+		}
+	}
+	update_isr();
+}
+
+u32 XIic_ReadReg(UINTPTR BaseAddress, u32 RegOffset)
+{
+	u32 v = 0;
+
+	(void)BaseAddress;
+	switch (RegOffset) {
+	case XIIC_DGIER_OFFSET:   return gie;
+	case XIIC_IISR_OFFSET:    return isr;
+	case XIIC_IIER_OFFSET:    return ier;
+	case XIIC_CR_REG_OFFSET:  return cr;
+	case XIIC_SR_REG_OFFSET:
+		if (tx_count == 0)            v |= XIIC_SR_TX_FIFO_EMPTY_MASK;
+		if (tx_count == FIFO_DEPTH)   v |= XIIC_SR_TX_FIFO_FULL_MASK;
+		if (state != IDLE && state != STALLED) v |= XIIC_SR_BUS_BUSY_MASK;
+		if (rx_count == 0)            v |= XIIC_SR_RX_FIFO_EMPTY_MASK;
+		if (rx_count == FIFO_DEPTH)   v |= XIIC_SR_RX_FIFO_FULL_MASK;
+		return v;
+	case XIIC_DRR_REG_OFFSET:
+		if (rx_count) {
+			v = rx_fifo[rx_head];
+			rx_head = (rx_head + 1) % FIFO_DEPTH;
+			rx_count--;
+			receive();
+		}
+		return v;
+	case XIIC_TFO_REG_OFFSET: return tx_count ? tx_count - 1 : 0;
+	case XIIC_RFO_REG_OFFSET: return rx_count ? rx_count - 1 : 0;
+	case XIIC_RFD_REG_OFFSET: return rfd;
+	case XIIC_GPO_REG_OFFSET: return gpo;
+	default:
+		if (RegOffset >= 0x128 && RegOffset <= 0x144) return timing[(RegOffset - 0x128) / 4];
+		return 0;
+	}
+}
+
+void XIic_WriteReg(UINTPTR BaseAddress, u32 RegOffset, u32 RegisterValue)
+{
+	(void)BaseAddress;
+	switch (RegOffset) {
+	case XIIC_DGIER_OFFSET:   gie = RegisterValue; break;
+	case XIIC_IISR_OFFSET:    isr ^= RegisterValue; update_isr(); break; //toggle on write
+	case XIIC_IIER_OFFSET:    ier = RegisterValue; break;
+	case XIIC_RESETR_OFFSET:  if (RegisterValue == XIIC_RESET_MASK) reset(); break;
+	case XIIC_CR_REG_OFFSET:
+		cr = RegisterValue & ~XIIC_CR_TX_FIFO_RESET_MASK;
+		if (RegisterValue & XIIC_CR_TX_FIFO_RESET_MASK) {
+			tx_count = 0;
+			if (state == STALLED) state = IDLE;
+			update_isr();
+		}
+		break;
+	case XIIC_DTR_REG_OFFSET: tx_entry(RegisterValue); break;
+	case XIIC_RFD_REG_OFFSET: rfd = RegisterValue & 0xF; update_isr(); break; //the FIFO may already hold enough
+	case XIIC_GPO_REG_OFFSET: gpo = RegisterValue; break;
+	default:
+		if (RegOffset >= 0x128 && RegOffset <= 0x144) {
+			timing[(RegOffset - 0x128) / 4] = RegisterValue;
+			/* PG090: SCL high lasts THIGH + 7 cycles, SCL low TLOW + 1 */
+			if (timing[TIMING_THIGH] && timing[TIMING_TLOW]) {
+				mmc_sim_set_scl(AXI_HZ / (timing[TIMING_THIGH] + 7 + timing[TIMING_TLOW] + 1));
+			}
+		}
+	}
+}
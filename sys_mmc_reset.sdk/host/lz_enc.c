@@ -0,0 +1,67 @@
+/*
+ * Info   : Greedy LZ4-style compressor (see lz_enc.h): one hash table entry
+ *          per 4 byte prefix, the last position is kept.
+ */
+
+#include <string.h>
+#include "lz_enc.h"
+#include "lz.h"
+
+#define HASH_BITS 14
+
+static u32 hash4(const u8 *p)
+{
+	u32 v = p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+
+	return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static u8 *put_len(u8 *op, u32 len)
+{
+	for (; len >= 255; len -= 255) *op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+static u8 *put_seq(u8 *op, const u8 *lit, u32 nlit, u32 offset, u32 mlen)
+{
+	u8 *token = op++;
+	u32 m = mlen ? mlen - LZ_MIN_MATCH : 0;
+
+	*token = ((nlit < 15 ? nlit : 15) << 4) | (m < 15 ? m : 15);
+	if (nlit >= 15) op = put_len(op, nlit - 15);
+	memcpy(op, lit, nlit);
+	op += nlit;
+	if (mlen) {
+		*op++ = offset;
+		*op++ = offset >> 8;
+		if (m >= 15) op = put_len(op, m - 15);
+	}
+	return op;
+}
+
+u32 lz_compress(const u8 *in, u32 n, u8 *out)
+{
+	static u32 table[1 << HASH_BITS];
+	u32 i = 0, anchor = 0, cand, h, len;
+	u8 *op = out;
+
+	memset(table, 0xFF, sizeof(table));
+	while (i + LZ_MIN_MATCH <= n) {
+		h = hash4(in + i);
+		cand = table[h];
+		table[h] = i;
+		if (cand == 0xFFFFFFFF || i - cand > LZ_WINDOW || memcmp(in + cand, in + i, LZ_MIN_MATCH)) {
+			i++;
+			continue;
+		}
+		for (len = LZ_MIN_MATCH; i + len < n && in[cand + len] == in[i + len]; len++);
+		op = put_seq(op, in + anchor, i - anchor, i - cand, len);
+		i += len;
+		anchor = i;
+	}
+
+	/* last sequence: literals only */
+	op = put_seq(op, in + anchor, n - anchor, 0, 0);
+	return op - out;
+}
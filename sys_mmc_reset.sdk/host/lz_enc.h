@@ -0,0 +1,17 @@
+/*
+ * Info   : Host side LZ4-style compressor producing the stream decoded by lz.c
+ *          (match offsets limited to LZ_WINDOW).
+ */
+
+#ifndef LZ_ENC_H
+#define LZ_ENC_H
+
+#include <xil_types.h>
+
+/* Compress N bytes of IN into OUT, that shall hold at least N + N/255 + 16 bytes
+ *
+ *  returns: the compressed size
+ */
+u32 lz_compress(const u8 *in, u32 n, u8 *out);
+
+#endif // LZ_ENC_H
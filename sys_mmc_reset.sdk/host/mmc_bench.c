@@ -0,0 +1,812 @@
+/*
+ * Info   : Host benchmark of the mmc_* layer against the MMC model.
+ *          Copies a file between two flash sections with mmc_flash_file_copy()
+ *          and reports the bus statistics at 100 kHz and 400 kHz, with and
+ *          without repeated START chaining of the register writes, then
+ *          re-stages an image that differs by a few KiB with and without
+ *          MMC_COPY_DIFF, resumes an interrupted copy and uploads a file
+ *          through the console model with upload_file(), raw and compressed,
+ *          then as a patch with upload_patch(). Last, the image is written to
+ *          the SD card with sd_write() in odd chunks and read back with and
+ *          without read ahead, and dumped from the flash and from the SD card
+ *          to the console model with dump_range(). The file metadata cache
+ *          is checked for bus traffic and coherence with WRLEN. The same copy
+ *          runs on several MMCs sharing the bus, one after the other and
+ *          interleaved with mmc_multi_copy(). The bus speed is negotiated
+ *          with MMC models of different maximum rates.
+ *
+ * Build  : gcc -O2 -I. -I../sw/src -o mmc_bench mmc_bench.c mmc_sim.c xiic_sim.c iic_sim.c delay_sim.c console_sim.c lz_enc.c patch_enc.c \
+ *              ../sw/src/mmc.c ../sw/src/mmc_bus.c ../sw/src/mmc_xfer.c ../sw/src/iic_fifo.c ../sw/src/crc32.c \
+ *              ../sw/src/upload.c ../sw/src/lz.c ../sw/src/patch.c ../sw/src/sd.c ../sw/src/dump.c \
+ *              ../sw/src/sched.c ../sw/src/console.c
+ *          add -DMMC_BUS_BACKEND=2 to run on the AXI IIC register model with iic_fifo.c
+ * Usage  : mmc_bench [-s scl_hz] [-n file_size] [-q] [-S] [-c console_byte_ns]
+ *          -S: the MMC model does not stretch the clock while a command is running
+ *          -c: time of one console byte in the upload benchmark (default 10000 ns)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mmc.h"
+#include "mmc_bus.h"
+#include "mmc_xfer.h"
+#include "xiic.h"
+#include "mmc_sim.h"
+#include "crc32.h"
+#include "upload.h"
+#include "sd.h"
+#include "dump.h"
+#include "console_sim.h"
+#include "lz_enc.h"
+#include "patch_enc.h"
+
+#define SRC_ID 0
+#define DST_ID 1
+#define SD_BASE 0x10123 //SD card address of the image, neither sector nor half aligned
+#define SD_CHUNK 100    //bytes per sd_write() call
+
+static u8 image[FLASH_FILE_SIZE];
+static u8 old_image[FLASH_FILE_SIZE];
+static u8 fw_image[FLASH_FILE_SIZE];
+static u8 new_image[FLASH_FILE_SIZE];
+static u8 lz_image[FLASH_FILE_SIZE + FLASH_FILE_SIZE / 255 + 16];
+static u8 dump_out[FLASH_FILE_SIZE * 5 / 2 + 4096]; //Intel HEX takes 77 bytes per 32 bytes
+static u32 console_ns = 10000;
+
+/* pseudo random image whose last eighth is 0xFF padding */
+static void make_image(u32 len)
+{
+	u32 i, x = 0x12345678;
+
+	for (i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		image[i] = (i < len - len / 8) ? x >> 16 : 0xFF;
+	}
+}
+
+/* check crc32.c against the check value of CRC-32/IEEE and against the bitwise
+ * CRC of the MMC model, on random lengths, alignments and chunk splits
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int crc_test(void)
+{
+	static const struct { const char *s; u32 crc; } vec[] = {
+		{"", 0x00000000},
+		{"a", 0xE8B7BE43},
+		{"123456789", 0xCBF43926},
+		{"The quick brown fox jumps over the lazy dog", 0x414FA339},
+	};
+	u32 i, n, off, split, crc, ref, nvec = 0;
+
+	for (i = 0; i < sizeof(vec) / sizeof(vec[0]); i++, nvec++) {
+		crc = crc32_update(0, (const u8 *)vec[i].s, strlen(vec[i].s));
+		if (crc != vec[i].crc) {
+			printf("crc_test::ERROR::\"%s\" gives 0x%08X instead of 0x%08X\n", vec[i].s, crc, vec[i].crc);
+			return 1;
+		}
+	}
+
+	srand(1);
+	for (i = 0; i < 2000; i++, nvec++) {
+		n     = rand() % 1100;
+		off   = rand() % 4;
+		split = n ? rand() % n : 0;
+		ref   = mmc_sim_crc32(image + off, n);
+		crc   = crc32_update(crc32_update(0, image + off, split), image + off + split, n - split);
+		if (crc != ref) {
+			printf("crc_test::ERROR::%u bytes at +%u split at %u: 0x%08X instead of 0x%08X\n", n, off, split, crc, ref);
+			return 1;
+		}
+	}
+
+	printf("crc32 check: %u vectors OK\n", nvec);
+	return 0;
+}
+
+/* hide the console output between quiet_begin() and quiet_end() if QUIET */
+static int quiet_begin(int quiet)
+{
+	int fd = -1;
+
+	if (quiet) {
+		fflush(stdout);
+		fd = dup(1);
+		dup2(open("/dev/null", O_WRONLY), 1);
+	}
+	return fd;
+}
+
+static void quiet_end(int fd)
+{
+	if (fd >= 0) {
+		fflush(stdout);
+		dup2(fd, 1);
+		close(fd);
+	}
+}
+
+/* run mmc_flash_file_copy(), with its console output hidden if QUIET
+ *
+ * returns: the copy result
+ */
+static int copy_file(u8 flags, int quiet)
+{
+	int ret, fd = quiet_begin(quiet);
+
+	ret = mmc_flash_file_copy(SRC_ID, DST_ID, flags);
+	quiet_end(fd);
+	return ret;
+}
+
+/* run one copy on a freshly initialized model and check the destination
+ *  OLD     : initial content of the destination file, NULL if erased
+ *  RESET_AT: if not 0, a first copy is interrupted by an MMC reset at this
+ *            command, the statistics are those of the copy that follows it
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int run_copy(const char *title, u32 scl_hz, u32 len, const u8 *old, u8 flags, u32 reset_at, int quiet,
+                    mmc_sim_stats *st)
+{
+	clock_t t0, t1;
+	int ret;
+	u32 skipped;
+
+	mmc_sim_init(scl_hz);
+	mmc_sim_load_file(SRC_ID, image, len);
+	if (old) mmc_sim_load_file(DST_ID, old, len);
+	mmc_bus_set_scl_hz(scl_hz);
+	mmc_reset_stats();
+	mmc_shadow_invalidate(); //new model, registers are cleared
+	mmc_file_meta_invalidate();
+
+	if (reset_at) {
+		mmc_sim_reset_after(reset_at);
+		if (copy_file(flags, 1) == 0) {
+			printf("mmc_bench::ERROR::%s: the copy was not interrupted\n", title);
+			return 1;
+		}
+		mmc_sim_reset_stats();
+		mmc_reset_stats();
+	}
+	skipped = mmc_shadow_skipped();
+
+	t0  = clock();
+	ret = copy_file(flags, quiet);
+	t1  = clock();
+
+	if (ret != 0 || memcmp(mmc_sim_flash() + DST_ID * FLASH_FILE_SIZE, image, len)) {
+		printf("mmc_bench::ERROR::%s of 0x%08X bytes failed at %u Hz\n", title, len, scl_hz);
+		return 1;
+	}
+
+	mmc_sim_print_stats(title);
+	printf("  pages read %u, skipped %u, blank %u, programmed %u, sectors erased %u\n", mmc_get_copy_stats()->pages_read,
+	       mmc_get_copy_stats()->pages_skipped, mmc_get_copy_stats()->pages_blank,
+	       mmc_get_copy_stats()->pages_programmed, mmc_get_copy_stats()->sectors_erased);
+	printf("  CRC of the copied data 0x%08X, checkpoints %u\n", mmc_get_copy_stats()->crc, mmc_get_copy_stats()->checkpoints);
+	printf("  register writes skipped by the shadow %u\n", mmc_shadow_skipped() - skipped);
+	printf("  host CPU time %.3f ms\n", 1e3 * (t1 - t0) / CLOCKS_PER_SEC);
+	printf("  time estimated by the mmc layer %.1f ms, model elapsed time %.1f ms",
+	       mmc_stats_time_us() / 1e3, mmc_sim_elapsed_ns() / 1e6);
+	mmc_print_stats();
+	printf("\n");
+	*st = *mmc_sim_get_stats();
+	return 0;
+}
+
+#if MMC_BUS_BACKEND == MMC_BUS_FIFO
+/* register accesses needed by the FIFO driver to fetch one flash buffer,
+ * then a write longer than the FIFO to an address nobody acknowledges: the
+ * core keeps the unsent entries and the driver shall abort
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int fifo_report(void)
+{
+	u8 buf[MMC_FLASH_BUF_LEN];
+	iic_fifo_stats *st = iic_fifo_get_stats();
+
+	iic_fifo_reset_stats();
+	mmc_get_buffer(buf, MMC_FLASH_BUF_LEN);
+	printf("mmc_get_buffer(%d) with iic_fifo: %u register reads (%u status polls), %u register writes\n",
+	       MMC_FLASH_BUF_LEN, st->reg_rd, st->polls, st->reg_wr);
+
+	iic_fifo_reset_stats();
+	if (mmc_bus_send(MMC_I2C_ADDR7 + MMC_SIM_DEVS, buf, 2 * IIC_FIFO_DEPTH, XIIC_STOP) != 0 || st->errors != 1
+	    || mmc_get_buffer(buf, MMC_FLASH_BUF_LEN) != MMC_FLASH_BUF_LEN) {
+		printf("mmc_bench::ERROR::the FIFO driver did not recover from an address NACK\n");
+		return 1;
+	}
+	return 0;
+}
+#endif
+
+#if MMC_BUS_BACKEND == MMC_BUS_IRQ
+/* starts refused while the STOP of the previous transaction is on the bus,
+ * then a bus that stays busy: the waits of the queue shall give up
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int irq_report(void)
+{
+	u8  buf[20];
+	u32 busy = xiic_sim_bus_busy(), errors = mmc_xfer_errors();
+
+	xiic_sim_set_hang(1);
+	mmc_get_cmd_res();
+	xiic_sim_set_hang(0);
+	errors = mmc_xfer_errors() - errors;
+	printf("interrupt backend: %u starts found the bus busy after a STOP, a hung bus dropped %u transactions\n",
+	       busy, errors);
+	if (busy == 0 || errors == 0 || mmc_get_cmd_regs(buf) != sizeof(buf)) {
+		printf("mmc_bench::ERROR::the interrupt backend did not recover\n");
+		return 1;
+	}
+	return 0;
+}
+#endif
+
+static int bench(u32 scl_hz, u32 len, int quiet)
+{
+	mmc_sim_stats plain, chained;
+	u32 pages = (len + MMC_FLASH_BUF_LEN - 1) / MMC_FLASH_BUF_LEN;
+	double period_ns = 1e9 / scl_hz, saved_ns;
+
+	mmc_chain_enable(0);
+	if (run_copy("copy, STOP after every write", scl_hz, len, NULL, 0, 0, quiet, &plain)) return 1;
+	mmc_chain_enable(1);
+	if (run_copy("copy, writes chained with repeated START", scl_hz, len, NULL, 0, 0, quiet, &chained)) return 1;
+
+	saved_ns = (double)plain.bus_ns - (double)chained.bus_ns;
+	printf("  repeated START saves %.1f SCL cycles (%.1f us) per page, %.2f%% of the bus time\n",
+	       saved_ns / period_ns / pages, saved_ns / 1e3 / pages, 100.0 * saved_ns / plain.bus_ns);
+	return 0;
+}
+
+/* re-stage an image that differs from the destination by a few KiB:
+ *  a 2KiB block that needs an erase and 1KiB where bits are only cleared
+ */
+static int update_bench(u32 scl_hz, u32 len, int quiet)
+{
+	mmc_sim_stats full, diff;
+	u32 i;
+
+	memcpy(old_image, image, len);
+	for (i = len / 3; i < len / 3 + 2048 && i < len; i++) image[i] ^= 0x5A;
+	for (i = 2 * len / 3; i < 2 * len / 3 + 1024 && i < len; i++) image[i] &= 0xF0;
+
+	if (run_copy("update, full copy", scl_hz, len, old_image, 0, 0, quiet, &full)) return 1;
+	if (run_copy("update, MMC_COPY_DIFF", scl_hz, len, old_image, MMC_COPY_DIFF, 0, quiet, &diff)) return 1;
+	printf("  differential update is %.1f times faster\n", (double)full.bus_ns / diff.bus_ns);
+
+	memcpy(image, old_image, len);
+	return 0;
+}
+
+/* interrupt a copy with an MMC reset at about 3/4 of its commands and resume it */
+static int resume_bench(u32 scl_hz, u32 len, int quiet)
+{
+	mmc_sim_stats full, resumed;
+
+	if (run_copy("copy", scl_hz, len, NULL, 0, 0, quiet, &full)) return 1;
+	if (run_copy("copy resumed after an MMC reset", scl_hz, len, NULL, 0, 3 * full.cmds / 4, quiet, &resumed)) return 1;
+	printf("  the resumed copy takes %.1f%% of the time of a full copy\n",
+	       100.0 * (double)resumed.bus_ns / full.bus_ns);
+	return 0;
+}
+
+/* firmware-like image: code (random), repeated tables and 0xFF padding, 1KiB each in turn */
+static void make_fw_image(u32 len)
+{
+	u32 i, x = 0x9E3779B9;
+
+	for (i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		switch ((i / 1024) % 4) {
+		case 0:  fw_image[i] = x >> 16; break;
+		case 3:  fw_image[i] = 0xFF; break;
+		default: fw_image[i] = (i % 256) * 7 + (i / 65536);
+		}
+	}
+}
+
+/* next revision of the firmware-like image: 96 bytes inserted at 1/4, 64 bytes removed at 1/2
+ * and 16 words changed, the size is limited to LEN
+ */
+static void make_new_image(u32 len)
+{
+	u32 i, n, a = len / 4, b = len / 2;
+
+	memcpy(new_image, fw_image, a);
+	for (i = 0; i < 96; i++) new_image[a + i] = i * 37;
+	n = a + 96;
+	memcpy(new_image + n, fw_image + a, b - a);
+	n += b - a;
+	memcpy(new_image + n, fw_image + b + 64, len - b - 64);
+	for (i = 0; i < 16; i++) new_image[(i * 2 + 1) * (len / 32) & ~3] ^= 0x5A;
+}
+
+/* upload the firmware-like image to file DST_ID through the console model, compressed if FLAGS has UPLOAD_LZ
+ *  With UPLOAD_PATCH the image is stored as file SRC_ID and the next revision is sent as a patch
+ *  One frame in 64 is damaged
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int upload_bench(u32 scl_hz, u32 len, u8 flags, int quiet)
+{
+	mmc_sim_stats *st = mmc_sim_get_stats();
+	upload_stats *up = upload_get_stats();
+	double s;
+	const u8 *img = fw_image;
+	int ret, fd = -1;
+
+	make_fw_image(len);
+	mmc_sim_init(scl_hz);
+	mmc_reset_cmd_stats();
+	mmc_shadow_invalidate();
+	mmc_file_meta_invalidate();
+	if (flags & UPLOAD_PATCH) {
+		make_new_image(len);
+		img = new_image;
+		mmc_sim_load_file(SRC_ID, fw_image, len);
+		console_sim_upload(lz_image, patch_make(fw_image, len, new_image, len, lz_image), 64, console_ns);
+	} else if (flags & UPLOAD_LZ) {
+		console_sim_upload(lz_image, lz_compress(fw_image, len, lz_image), 64, console_ns);
+	} else {
+		console_sim_upload(fw_image, len, 64, console_ns);
+	}
+
+	if (quiet) {
+		fflush(stdout);
+		fd = dup(1);
+		dup2(open("/dev/null", O_WRONLY), 1);
+	}
+	ret = (flags & UPLOAD_PATCH) ? upload_patch(SRC_ID, DST_ID) : upload_file(DST_ID, flags);
+	if (quiet) {
+		fflush(stdout);
+		dup2(fd, 1);
+		close(fd);
+	}
+
+	if (ret != 0 || console_sim_done() != 1 || memcmp(mmc_sim_flash() + DST_ID * FLASH_FILE_SIZE, img, len)) {
+		printf("mmc_bench::ERROR::upload of 0x%08X bytes failed at %u Hz\n", len, scl_hz);
+		return 1;
+	}
+
+	mmc_sim_print_stats((flags & UPLOAD_PATCH) ? "patch upload over the console" :
+	                    (flags & UPLOAD_LZ) ? "compressed upload over the console" : "upload over the console");
+	s = mmc_sim_time_ns() / 1e9;
+	printf("  frames %u (%u bytes), rejected %u, resent %u, file CRC 0x%08X\n", up->frames, up->rx_bytes, up->errors,
+	       console_sim_resent(), up->crc);
+	printf("  %.1f KiB/s with a %.1f KB/s console, I2C bus busy %.1f%% of the time\n", len / 1024.0 / s,
+	       1e6 / console_ns, 100.0 * st->bus_ns / (s * 1e9));
+	return 0;
+}
+
+/* read the image back from the SD card in pages, with read ahead if AHEAD
+ *  The caller is modelled as sending every page over the console
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int sd_read_back(u32 len, int ahead)
+{
+	sd_stats *sd = sd_get_stats();
+	u32 i, k;
+
+	mmc_sim_reset_stats();
+	sd_reset_stats();
+	sd_read_ahead(ahead);
+	memset(old_image, 0, len);
+	for (i = 0; i < len; i += k) {
+		k = (len - i > MMC_FLASH_BUF_LEN) ? MMC_FLASH_BUF_LEN : len - i;
+		if (sd_read(SD_BASE + i, old_image + i, k)) return 1;
+		mmc_sim_idle((u64)k * console_ns);
+	}
+	if (sd_flush() || memcmp(old_image, image, len)) {
+		printf("mmc_bench::ERROR::SD read back differs\n");
+		return 1;
+	}
+	mmc_sim_print_stats(ahead ? "SD read back with read ahead" : "SD read back");
+	printf("  SDREAD %u (%u read ahead), cache hits %u\n", sd->reads, sd->reads_ahead, sd->cache_hits);
+	return 0;
+}
+
+/* write the image to the SD card in SD_CHUNK byte pieces at SD_BASE, check that
+ * the rest of the first and last sectors is kept, then read it back
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int sd_bench(u32 scl_hz, u32 len)
+{
+	sd_stats *sd = sd_get_stats();
+	u8 *card;
+	u32 i, k;
+
+	mmc_sim_init(scl_hz);
+	mmc_reset_cmd_stats();
+	mmc_shadow_invalidate();
+	mmc_file_meta_invalidate();
+	card = mmc_sim_sd();
+	for (i = 0; i < SD_BASE + len + SD_SECTOR_SIZE; i++) card[i] = i * 13 + 5;
+
+	sd_reset_stats();
+	for (i = 0; i < len; i += k) {
+		k = (len - i > SD_CHUNK) ? SD_CHUNK : len - i;
+		if (sd_write(SD_BASE + i, image + i, k)) return 1;
+	}
+	if (sd_flush()) return 1;
+
+	if (memcmp(card + SD_BASE, image, len)) {
+		printf("mmc_bench::ERROR::SD card data differs from the image\n");
+		return 1;
+	}
+	for (i = SD_BASE & ~(SD_SECTOR_SIZE - 1); i < ((SD_BASE + len + SD_SECTOR_SIZE - 1) & ~(SD_SECTOR_SIZE - 1)); i++) {
+		if (i == SD_BASE) i += len;
+		if (card[i] != (u8)(i * 13 + 5)) {
+			printf("mmc_bench::ERROR::SD card byte 0x%08X next to the image was lost\n", i);
+			return 1;
+		}
+	}
+	mmc_sim_print_stats("SD write in 100 byte pieces");
+	printf("  SDPROG %u, halves read back %u, %.1f KiB/s\n", sd->writes, sd->rmw_reads,
+	       len / 1024.0 / (mmc_sim_time_ns() / 1e9));
+
+	if (sd_read_back(len, 0) || sd_read_back(len, 1)) return 1;
+	sd_read_ahead(1);
+	return 0;
+}
+
+static u32 hex_val(const u8 *p, int n)
+{
+	u32 v = 0;
+
+	for (; n; n--, p++) v = (v << 4) | ((*p <= '9') ? *p - '0' : *p - 'A' + 10);
+	return v;
+}
+
+/* decode the Intel HEX text of N bytes in dump_out into OUT, that starts at address BASE
+ *
+ * returns: number of data bytes, 0xFFFFFFFF on a format or checksum error
+ */
+static u32 parse_hex(u32 n, u32 base, u8 *out)
+{
+	u32 i = 0, seg = 0, len, adr, type, total = 0, j;
+	u8  sum;
+
+	while (i < n) {
+		if (dump_out[i] != ':') return 0xFFFFFFFF;
+		len  = hex_val(dump_out + i + 1, 2);
+		adr  = hex_val(dump_out + i + 3, 4);
+		type = hex_val(dump_out + i + 7, 2);
+		sum  = 0;
+		for (j = 0; j < len + 5; j++) sum += hex_val(dump_out + i + 1 + 2 * j, 2);
+		if (sum != 0) return 0xFFFFFFFF;
+		if (type == 0x04) {
+			seg = hex_val(dump_out + i + 9, 4) << 16;
+		} else if (type == 0x00) {
+			for (j = 0; j < len; j++) out[seg + adr + j - base] = hex_val(dump_out + i + 9 + 2 * j, 2);
+			total += len;
+		} else if (type == 0x01) {
+			return total;
+		}
+		i += 1 + 2 * (len + 5) + 2;
+	}
+	return 0xFFFFFFFF;
+}
+
+/* decode the binary frames of N bytes in dump_out into OUT
+ *
+ * returns: number of data bytes, 0xFFFFFFFF on a format or CRC error
+ */
+static u32 parse_bin(u32 n, u8 *out)
+{
+	u32 i = 0, len, crc, total = 0;
+	u8  seq = 0;
+
+	while (i + 8 <= n) {
+		len = buf8_to_16((dump_out + i + 2));
+		crc = crc32_update(0, dump_out + i + 1, 3 + len);
+		if (dump_out[i] != UPLOAD_SOF || dump_out[i + 1] != seq++ || crc != (u32)buf8_to_32((dump_out + i + 4 + len))) {
+			return 0xFFFFFFFF;
+		}
+		if (len == 0) return total;
+		memcpy(out + total, dump_out + i + 4, len);
+		total += len;
+		i += 8 + len;
+	}
+	return 0xFFFFFFFF;
+}
+
+/* dump LEN bytes of the image from the flash (file SRC_ID) or the SD card (SD_BASE) with dump_range()
+ * and decode the console output
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int dump_one(u32 len, u8 flags)
+{
+	u32 adr = (flags & DUMP_SD) ? SD_BASE : SRC_ID * FLASH_FILE_SIZE + 0x10;
+	u64 t0 = mmc_sim_time_ns();
+	u32 out, got;
+	double s;
+
+	if (!(flags & DUMP_SD)) len -= 0x10;
+	console_sim_capture(dump_out, sizeof(dump_out), console_ns);
+	if (dump_range(adr, len, flags)) return 1;
+	out = console_sim_captured();
+
+	memset(old_image, 0, len);
+	got = (flags & DUMP_BIN) ? parse_bin(out, old_image) : parse_hex(out, adr, old_image);
+	if (got != len || memcmp(old_image, image + ((flags & DUMP_SD) ? 0 : 0x10), len)) {
+		printf("mmc_bench::ERROR::dump of 0x%08X bytes at 0x%08X does not decode to the image\n", len, adr);
+		return 1;
+	}
+
+	s = (mmc_sim_time_ns() - t0) / 1e9;
+	printf("dump of %s as %s: %u bytes out, %.1f KiB/s, console busy %.1f%% of the time\n",
+	       (flags & DUMP_SD) ? "SD card" : "flash", (flags & DUMP_BIN) ? "binary frames" : "Intel HEX",
+	       out, len / 1024.0 / s, 100.0 * out * console_ns / (s * 1e9));
+	return 0;
+}
+
+static int dump_bench(u32 scl_hz, u32 len)
+{
+	mmc_sim_init(scl_hz);
+	mmc_reset_cmd_stats();
+	mmc_shadow_invalidate();
+	mmc_file_meta_invalidate();
+	mmc_sim_load_file(SRC_ID, image, len);
+	memcpy(mmc_sim_sd() + SD_BASE, image, len);
+
+	return dump_one(len, 0) || dump_one(len, DUMP_BIN) || dump_one(len, DUMP_SD) || dump_one(len, DUMP_SD | DUMP_BIN);
+}
+
+/* list the files twice, copy one and check that its metadata is known without
+ * reading it again, then change its length behind the copy code with WRLEN
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int meta_bench(u32 scl_hz, u32 len, int quiet)
+{
+	mmc_sim_stats *st = mmc_sim_get_stats();
+	const mmc_file_meta *m;
+	u32 cmds[3];
+	double ms;
+
+	mmc_sim_init(scl_hz);
+	mmc_sim_load_file(SRC_ID, image, len);
+	mmc_shadow_invalidate();
+	mmc_file_meta_invalidate();
+
+	mmc_sim_reset_stats();
+	if (mmc_file_meta_load()) return 1;
+	cmds[0] = st->cmds;
+	ms = st->bus_ns / 1e6;
+	mmc_sim_reset_stats();
+	if (mmc_file_meta_load()) return 1;
+	cmds[1] = st->cmds;
+
+	if (copy_file(0, quiet)) return 1;
+	mmc_sim_reset_stats();
+	m = mmc_file_meta_get(DST_ID);
+	cmds[2] = st->cmds;
+	if (!m || m->size != len || m->crc != mmc_sim_crc32(image, len)) {
+		printf("mmc_bench::ERROR::metadata of the copied file is wrong\n");
+		return 1;
+	}
+
+	mmc_set_addr(DST_ID * FLASH_FILE_SIZE);
+	mmc_set_data(len / 2);
+	mmc_unlock();
+	mmc_run_cmd(MMC_CMD_WRLEN);
+	m = mmc_file_meta_get(DST_ID);
+	if (!m || m->size != len / 2) {
+		printf("mmc_bench::ERROR::metadata cache not updated after WRLEN\n");
+		return 1;
+	}
+
+	printf("file metadata @ %u Hz: first listing %u commands (%.1f ms of bus), second %u, after a copy %u\n",
+	       scl_hz, cmds[0], ms, cmds[1], cmds[2]);
+	return 0;
+}
+
+/* negotiate the bus speed with an MMC that answers up to LIMIT_HZ (0: no limit), then copy a file
+ *  LOWER_HZ: if not 0, the MMC answers only up to this rate from the start of the copy on: the
+ *            copy fails, then mmc_speed_recover() negotiates again and the copy is run once more
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int speed_one(u32 limit_hz, u32 lower_hz, u32 len, int quiet)
+{
+	u8  sp;
+	int ret;
+
+	mmc_sim_init(MMC_BUS_SCL_HZ);
+	mmc_sim_set_max_scl(limit_hz);
+	mmc_sim_load_file(SRC_ID, image, len);
+	mmc_shadow_invalidate();
+	mmc_file_meta_invalidate();
+
+	sp = mmc_speed_negotiate(MMC_BUS_SPEED_FMP);
+	printf("speed negotiation, MMC up to %u kHz: %u kHz", limit_hz ? limit_hz / 1000 : 1000, mmc_bus_get_scl_hz() / 1000);
+
+	mmc_reset_stats();
+	if (lower_hz) {
+		mmc_sim_set_max_scl(lower_hz);
+		if (copy_file(0, 1) == 0) {
+			printf("\nmmc_bench::ERROR::copy too fast for the MMC did not fail\n");
+			return 1;
+		}
+		mmc_speed_recover(MMC_BUS_SPEED_FMP);
+		mmc_shadow_invalidate();
+		mmc_file_meta_invalidate();
+	}
+	mmc_sim_reset_stats();
+	ret = copy_file(0, quiet);
+	printf(", copy%s at %u kHz in %.1f ms, %u fallbacks\n", lower_hz ? " with a slower MMC, after a failed one" : "",
+	       mmc_bus_get_scl_hz() / 1000, mmc_sim_elapsed_ns() / 1e6, mmc_bus_get_stats()->fallbacks);
+
+	mmc_sim_set_max_scl(0);
+	if (ret || memcmp(mmc_sim_flash() + DST_ID * FLASH_FILE_SIZE, image, len)) {
+		printf("mmc_bench::ERROR::copy after the speed negotiation failed\n");
+		return 1;
+	}
+	if (!lower_hz && sp != (limit_hz == 0 ? MMC_BUS_SPEED_FMP : limit_hz >= 400000 ? MMC_BUS_SPEED_FM : MMC_BUS_SPEED_SM)) {
+		printf("mmc_bench::ERROR::wrong speed profile %u\n", sp);
+		return 1;
+	}
+	return 0;
+}
+
+static int speed_bench(u32 len, int quiet)
+{
+	int ret = 0;
+
+	ret |= speed_one(0, 0, len, quiet);
+	ret |= speed_one(500000, 0, len, quiet);
+	ret |= speed_one(100000, 0, len, quiet);
+	ret |= speed_one(0, 500000, len, quiet);
+	mmc_bus_set_speed(MMC_BUS_SPEED_SM);
+
+	return ret;
+}
+
+/* copy the file on NT MMCs sharing the bus, one after the other with mmc_flash_file_copy()
+ * or interleaved with mmc_multi_copy() if MULTI, and check every destination
+ *  *MS: model time of the copies
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int multi_one(u32 scl_hz, u32 len, u32 nt, int multi, int quiet, double *ms)
+{
+	mmc_target tg[MMC_SIM_DEVS], *tp[MMC_SIM_DEVS];
+	u8  *flash;
+	u32 k;
+	int ret = 0, fd;
+
+	mmc_sim_init(scl_hz);
+	mmc_sim_set_devices(nt);
+	for (k = 0; k < nt; k++) {
+		mmc_sim_select(k);
+		mmc_sim_load_file(SRC_ID, image, len);
+		mmc_target_init(&tg[k], MMC_I2C_ADDR7 + k);
+		tp[k] = &tg[k];
+	}
+	mmc_bus_set_scl_hz(scl_hz);
+	mmc_reset_stats();
+
+	fd = quiet_begin(quiet);
+	if (multi) {
+		ret  = (mmc_multi_copy(tp, 0, SRC_ID, DST_ID) == 0); //no target is an error, not a copy
+		ret |= mmc_multi_copy(tp, nt, SRC_ID, DST_ID);
+	} else {
+		for (k = 0; k < nt; k++) {
+			mmc_target_select(tp[k]);
+			ret |= mmc_flash_file_copy(SRC_ID, DST_ID, 0);
+		}
+		mmc_target_select(NULL);
+	}
+	quiet_end(fd);
+	*ms = mmc_sim_elapsed_ns() / 1e6;
+
+	for (k = 0; k < nt; k++) {
+		mmc_sim_select(k);
+		flash = mmc_sim_flash();
+		if (memcmp(flash + DST_ID * FLASH_FILE_SIZE, image, len) ||
+		    (u32)buf8_to_32((flash + info_addr(DST_ID) + 8)) != mmc_sim_crc32(image, len)) {
+			ret = 1;
+		}
+	}
+	mmc_sim_select(0);
+	if (ret) printf("mmc_bench::ERROR::%s copy on %u MMCs failed\n", multi ? "interleaved" : "serial", nt);
+	return ret;
+}
+
+static int multi_bench(u32 scl_hz, u32 len, int quiet)
+{
+	double serial_ms, multi_ms;
+	u32 nt;
+	int ret = 0;
+
+	for (nt = 2; nt <= MMC_SIM_DEVS; nt *= 2) {
+		ret |= multi_one(scl_hz, len, nt, 0, quiet, &serial_ms);
+		ret |= multi_one(scl_hz, len, nt, 1, quiet, &multi_ms);
+		printf("copy on %u MMCs at %u kHz: one after the other %.1f ms, interleaved %.1f ms (%.1f%% less)\n",
+		       nt, scl_hz / 1000, serial_ms, multi_ms, 100.0 * (serial_ms - multi_ms) / serial_ms);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	u32 scl_hz = 0, len = FLASH_FILE_SIZE;
+	int i, quiet = 0, ret = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+			scl_hz = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+			len = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "-q")) {
+			quiet = 1;
+		} else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+			console_ns = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "-S")) {
+			mmc_sim_set_stretch(0);
+			mmc_set_stretch(0);
+		} else {
+			fprintf(stderr, "usage: %s [-s scl_hz] [-n file_size] [-q] [-S] [-c console_byte_ns]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (len == 0 || len > FLASH_FILE_SIZE) {
+		fprintf(stderr, "file size shall be in 1..0x%X\n", FLASH_FILE_SIZE);
+		return 2;
+	}
+
+	if (mmc_bus_init()) {
+		fprintf(stderr, "mmc_bench::ERROR::cannot initialize the bus backend\n");
+		return 1;
+	}
+
+	make_image(FLASH_FILE_SIZE);
+	if (crc_test()) return 1;
+	make_image(len);
+	if (scl_hz) {
+		ret |= bench(scl_hz, len, quiet);
+		ret |= update_bench(scl_hz, len, quiet);
+		ret |= resume_bench(scl_hz, len, quiet);
+		ret |= upload_bench(scl_hz, len, 0, quiet);
+		ret |= upload_bench(scl_hz, len, UPLOAD_LZ, quiet);
+		ret |= upload_bench(scl_hz, len, UPLOAD_PATCH, quiet);
+		ret |= sd_bench(scl_hz, len);
+		ret |= dump_bench(scl_hz, len);
+		ret |= meta_bench(scl_hz, len, quiet);
+		ret |= multi_bench(scl_hz, len, quiet);
+	} else {
+		ret |= bench(100000, len, quiet);
+		ret |= bench(400000, len, quiet);
+		ret |= update_bench(400000, len, quiet);
+		ret |= resume_bench(400000, len, quiet);
+		ret |= upload_bench(400000, len, 0, quiet);
+		ret |= upload_bench(400000, len, UPLOAD_LZ, quiet);
+		ret |= upload_bench(400000, len, UPLOAD_PATCH, quiet);
+		ret |= sd_bench(400000, len);
+		ret |= dump_bench(400000, len);
+		ret |= meta_bench(400000, len, quiet);
+		ret |= multi_bench(400000, len, quiet);
+	}
+	ret |= speed_bench(len, quiet);
+#if MMC_BUS_BACKEND == MMC_BUS_FIFO
+	ret |= fifo_report();
+#elif MMC_BUS_BACKEND == MMC_BUS_IRQ
+	ret |= irq_report();
+#endif
+
+	return ret;
+}
@@ -0,0 +1,496 @@
+/*
+ * Info   : Host model of the GPAC3 MMC I2C slave (see mmc_sim.h)
+ *
+ * Bus timing is modelled in SCL periods (T): START, repeated START and STOP
+ * cost one period each, every byte costs nine (eight bits plus ACK) and the
+ * bus free time between a STOP and the next START is half a period.
+ *
+ * Commands complete after a per-command latency. With clock stretching
+ * enabled (default, like the real MMC) the next address byte is held until
+ * the running command is done; without it the result register keeps the
+ * previous value until completion and commands written in the meantime are
+ * dropped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mmc_sim.h"
+#include "mmc.h"
+
+#define CMDBLK_LEN 20
+
+/* state of one MMC */
+typedef struct {
+	u8  *flash;
+	u8  *sd;
+	u8   cmdblk[CMDBLK_LEN];
+	u8   wbuf[MMC_FLASH_BUF_LEN];
+	u8   rbuf[MMC_FLASH_BUF_LEN];
+	u64  busy_until_ns;
+	u32  pending_res;
+	int  res_pending;
+	u32  reset_countdown; //commands left before an injected MMC reset, 0: none
+	u32  sd_half;         //SD sector whose lower half was written by the last command
+	u16  base;            //address set by the last write, reads start from here
+} mmc_dev;
+
+static mmc_dev devs[MMC_SIM_DEVS];
+static u32  ndevs = 1;        //devices answering on the bus
+static mmc_dev *d = &devs[0]; //device of the current transaction
+static mmc_dev *sel = &devs[0]; //device of the setup and backdoor calls
+
+static u32  scl_hz = 100000;
+static u32  max_scl_hz = 0; //0: no limit
+static int  stretch = 1;
+static u64  now_ns = 0;
+
+static int  bus_held = 0;   //START sent and no STOP yet
+static int  xfer_read = 0;  //current transaction direction
+static int  xfer_phase = 0; //0: pointer MSB, 1: pointer LSB, 2: data
+static int  xfer_lost = 0;  //the bus is too fast for the MMC: it acknowledges its address, then loses the bits
+static u16  ptr = 0;        //auto-incremented register address
+
+static mmc_sim_stats stats;
+static u64  stats_t0_ns = 0; //model time of the last statistics reset
+static mmc_sim_latency lat = {
+	100000,    //FREAD:  100 us
+	700000,    //FPROG:  700 us (page program)
+	200000000, //FERASE: 200 ms (64KiB sector)
+	500000,    //SDREAD: 500 us
+	2000000,   //SDPROG:   2 ms
+	40000000,  //WRLEN:   40 ms (rewrites the info sector)
+	50000,     //CRC:     50 us per KiB
+	1000000000 //RESET/IAP/TSD: 1 s
+};
+
+static u32 get32(const u8 *p)
+{
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+}
+
+static void put32(u8 *p, u32 v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static u64 period_ns(void)
+{
+	return 1000000000ULL / scl_hz;
+}
+
+static void advance(u64 ns)
+{
+	now_ns += ns;
+	stats.bus_ns += ns;
+}
+
+/* make a completed command visible in the result register of X */
+static void update(mmc_dev *x)
+{
+	if (x->res_pending && now_ns >= x->busy_until_ns) {
+		put32(x->cmdblk + 4, x->pending_res);
+		x->res_pending = 0;
+	}
+}
+
+static void update_all(void)
+{
+	u32 k;
+
+	for (k = 0; k < ndevs; k++) update(&devs[k]);
+}
+
+u32 mmc_sim_crc32(const u8 *buf, u32 n)
+{
+	u32 crc = 0xFFFFFFFF, i;
+	int b;
+
+	for (i = 0; i < n; i++) {
+		crc ^= buf[i];
+		for (b = 0; b < 8; b++) {
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+		}
+	}
+
+	return ~crc;
+}
+
+static u16 protected_cmd(u16 cmd)
+{
+	switch (cmd) {
+	case MMC_CMD_FREAD:
+	case MMC_CMD_SDREAD:
+	case MMC_CMD_NULL:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+static void reboot(void)
+{
+	memset(d->cmdblk, 0, sizeof(d->cmdblk));
+}
+
+static void execute(u16 cmd)
+{
+	u32 addr = get32(d->cmdblk + 8);
+	u32 data = get32(d->cmdblk + 12);
+	u32 key  = get32(d->cmdblk + 16);
+	u32 busy = 0, len, info, i;
+	u16 res  = MMC_SIM_RES_OK;
+
+	if (d->res_pending && now_ns < d->busy_until_ns) {
+		stats.cmds_dropped++;
+		return;
+	}
+	update(d);
+	stats.cmds++;
+	if (d->reset_countdown && --d->reset_countdown == 0) {
+		reboot(); //registers and key are lost, the command runs on cleared registers
+	}
+
+	if (cmd != MMC_CMD_SDPROG && cmd != MMC_CMD_NULL) d->sd_half = 0xFFFFFFFF;
+
+	if (protected_cmd(cmd) && key != MMC_SECURE_KEY) {
+		res = MMC_SIM_RES_ELOCKED;
+	} else switch (cmd) {
+	case MMC_CMD_NULL:
+		break;
+	case MMC_CMD_FREAD:
+		busy = lat.fread_ns;
+		if (addr > MMC_SIM_FLASH_SIZE - MMC_FLASH_BUF_LEN) {
+			res = MMC_SIM_RES_EADDR;
+		} else {
+			memcpy(d->rbuf, d->flash + addr, MMC_FLASH_BUF_LEN);
+		}
+		break;
+	case MMC_CMD_FPROG:
+		busy = lat.fprog_ns;
+		if (addr > MMC_SIM_FLASH_SIZE - MMC_FLASH_BUF_LEN) {
+			res = MMC_SIM_RES_EADDR;
+		} else {
+			for (i = 0; i < MMC_FLASH_BUF_LEN; i++) {
+				d->flash[addr + i] &= d->wbuf[i]; //programming can only clear bits
+			}
+		}
+		break;
+	case MMC_CMD_FERASE:
+		busy = lat.ferase_ns;
+		if ((addr % FLASH_SECTOR_SIZE) || addr >= MMC_SIM_FLASH_SIZE) {
+			res = MMC_SIM_RES_EADDR;
+		} else {
+			memset(d->flash + addr, 0xFF, FLASH_SECTOR_SIZE);
+		}
+		break;
+	case MMC_CMD_SDREAD:
+		busy = lat.sdread_ns;
+		if (addr > MMC_SIM_SD_SIZE - MMC_FLASH_BUF_LEN) {
+			res = MMC_SIM_RES_EADDR;
+		} else {
+			memcpy(d->rbuf, d->sd + addr, MMC_FLASH_BUF_LEN);
+		}
+		break;
+	case MMC_CMD_SDPROG:
+		busy = lat.sdprog_ns;
+		if (addr > MMC_SIM_SD_SIZE - MMC_FLASH_BUF_LEN) {
+			res = MMC_SIM_RES_EADDR;
+		} else {
+			//the rest of a partially written sector is erased, unless the upper half
+			//follows the lower one: the MMC then writes the whole sector
+			if (!(addr % SD_SECTOR_SIZE == MMC_FLASH_BUF_LEN && d->sd_half == addr - MMC_FLASH_BUF_LEN)) {
+				memset(d->sd + (addr & ~(SD_SECTOR_SIZE - 1)), 0, SD_SECTOR_SIZE);
+			}
+			memcpy(d->sd + addr, d->wbuf, MMC_FLASH_BUF_LEN);
+		}
+		d->sd_half = (addr % SD_SECTOR_SIZE) ? 0xFFFFFFFF : addr;
+		break;
+	case MMC_CMD_WRLEN:
+		busy = lat.wrlen_ns;
+		if (addr / FLASH_FILE_SIZE >= FLASH_INFO_ID) {
+			res = MMC_SIM_RES_EADDR;
+		} else if (data > FLASH_FILE_SIZE) {
+			res = MMC_SIM_RES_ELEN;
+		} else {
+			info = info_addr(addr / FLASH_FILE_SIZE);
+			memset(d->flash + info, 0xFF, FLASH_SECTOR_SIZE);
+			put32(d->flash + info + 4, data);
+		}
+		break;
+	case MMC_CMD_CRC:
+		if (addr / FLASH_FILE_SIZE >= FLASH_INFO_ID) {
+			res = MMC_SIM_RES_EADDR;
+			break;
+		}
+		info = info_addr(addr / FLASH_FILE_SIZE);
+		len  = get32(d->flash + info + 4);
+		if (len > FLASH_FILE_SIZE) {
+			res = MMC_SIM_RES_ELEN;
+			break;
+		}
+		busy = (u32)(((u64)lat.crc_ns_per_kib * len) / 1024);
+		put32(d->flash + info + 8,
+		      get32(d->flash + info + 8) & mmc_sim_crc32(d->flash + (addr / FLASH_FILE_SIZE) * FLASH_FILE_SIZE, len));
+		break;
+	case MMC_CMD_IAP0:
+	case MMC_CMD_IAP1:
+	case MMC_CMD_RESET:
+	case MMC_CMD_TSD:
+		busy = lat.reboot_ns;
+		reboot();
+		break;
+	default:
+		res = MMC_SIM_RES_EUNKNOWN;
+	}
+
+	d->pending_res   = ((u32)cmd << 16) | res;
+	d->res_pending   = 1;
+	d->busy_until_ns = now_ns + busy;
+	update(d);
+}
+
+static void reg_write(u16 a, u8 v)
+{
+	if (a >= MMC_XCMD_WREG && a < MMC_XCMD_WREG + CMDBLK_LEN) {
+		a -= MMC_XCMD_WREG;
+		if (a >= 4 && a < 8) return; //result register is read only
+		d->cmdblk[a] = v;
+		if (a == 1) execute((d->cmdblk[0] << 8) | d->cmdblk[1]);
+	} else if (a >= MMC_FLASH_WBUF_ADDR && a < MMC_FLASH_WBUF_ADDR + MMC_FLASH_BUF_LEN) {
+		d->wbuf[a - MMC_FLASH_WBUF_ADDR] = v;
+	}
+}
+
+static u8 reg_read(u16 a)
+{
+	update(d);
+	if (a >= MMC_XCMD_RREG && a < MMC_XCMD_RREG + CMDBLK_LEN) {
+		return d->cmdblk[a - MMC_XCMD_RREG];
+	} else if (a >= MMC_FLASH_WBUF_ADDR && a < MMC_FLASH_WBUF_ADDR + MMC_FLASH_BUF_LEN) {
+		return d->wbuf[a - MMC_FLASH_WBUF_ADDR];
+	} else if (a >= MMC_FLASH_RBUF_ADDR && a < MMC_FLASH_RBUF_ADDR + MMC_FLASH_BUF_LEN) {
+		return d->rbuf[a - MMC_FLASH_RBUF_ADDR];
+	}
+	return 0xFF;
+}
+
+/********************** setup *************************/
+/* blank flash and SD card, idle MMC */
+static void dev_init(mmc_dev *x)
+{
+	if (!x->flash) x->flash = malloc(MMC_SIM_FLASH_SIZE);
+	if (!x->sd)    x->sd    = malloc(MMC_SIM_SD_SIZE);
+	if (!x->flash || !x->sd) {
+		fprintf(stderr, "mmc_sim_init()::ERROR::out of memory\n");
+		exit(1);
+	}
+	memset(x->flash, 0xFF, MMC_SIM_FLASH_SIZE);
+	memset(x->sd, 0x00, MMC_SIM_SD_SIZE);
+	memset(x->wbuf, 0xFF, sizeof(x->wbuf));
+	memset(x->rbuf, 0xFF, sizeof(x->rbuf));
+	memset(x->cmdblk, 0, sizeof(x->cmdblk));
+
+	x->busy_until_ns = 0;
+	x->res_pending = 0;
+	x->reset_countdown = 0;
+	x->sd_half = 0xFFFFFFFF;
+	x->base = 0;
+}
+
+void mmc_sim_init(u32 hz)
+{
+	ndevs = 1;
+	d = sel = &devs[0];
+	dev_init(d);
+
+	now_ns = 0;
+	bus_held = 0;
+	ptr = 0;
+	mmc_sim_set_scl(hz);
+	mmc_sim_reset_stats();
+}
+
+void mmc_sim_set_devices(u32 n)
+{
+	if (n < 1) n = 1;
+	if (n > MMC_SIM_DEVS) n = MMC_SIM_DEVS;
+	for (; ndevs < n; ndevs++) dev_init(&devs[ndevs]);
+	ndevs = n;
+}
+
+void mmc_sim_select(u32 k)
+{
+	if (k < ndevs) sel = &devs[k];
+}
+
+void mmc_sim_set_max_scl(u32 hz)
+{
+	max_scl_hz = hz;
+}
+
+void mmc_sim_set_scl(u32 hz)
+{
+	scl_hz = hz ? hz : 100000;
+}
+
+u32 mmc_sim_get_scl(void)
+{
+	return scl_hz;
+}
+
+void mmc_sim_set_stretch(int on)
+{
+	stretch = on;
+}
+
+void mmc_sim_reset_after(u32 ncmds)
+{
+	sel->reset_countdown = ncmds;
+}
+
+mmc_sim_latency *mmc_sim_latencies(void)
+{
+	return &lat;
+}
+
+/********************** bus primitives *************************/
+int mmc_sim_start(u8 addr7, int read)
+{
+	if (bus_held) {
+		stats.rstarts++;
+	} else {
+		advance(period_ns() / 2); //bus free time
+	}
+	advance(period_ns());
+	stats.starts++;
+	bus_held = 1;
+
+	/* address byte */
+	advance(9 * period_ns());
+	stats.addr_bytes++;
+	if (addr7 < MMC_I2C_ADDR7 || addr7 >= MMC_I2C_ADDR7 + ndevs) {
+		stats.nacks++;
+		return 0;
+	}
+	xfer_lost = max_scl_hz && scl_hz > max_scl_hz;
+	d = &devs[addr7 - MMC_I2C_ADDR7];
+	if (stretch && d->res_pending && now_ns < d->busy_until_ns) {
+		stats.stretch_ns += d->busy_until_ns - now_ns;
+		advance(d->busy_until_ns - now_ns);
+	}
+	update(d);
+
+	xfer_read  = read;
+	xfer_phase = 0;
+	ptr        = d->base;
+	return 1;
+}
+
+int mmc_sim_write(u8 data)
+{
+	advance(9 * period_ns());
+	stats.bytes_tx++;
+
+	if (xfer_read) return 0;
+	if (xfer_lost && xfer_phase) { //the first data byte is the last one acknowledged
+		stats.nacks++;
+		return 0;
+	}
+
+	switch (xfer_phase) {
+	case 0:
+		ptr = data << 8;
+		xfer_phase = 1;
+		break;
+	case 1:
+		ptr |= data;
+		d->base = ptr;
+		xfer_phase = 2;
+		break;
+	default:
+		reg_write(ptr++, data);
+	}
+	return 1;
+}
+
+u8 mmc_sim_read(int ack)
+{
+	(void)ack;
+	advance(9 * period_ns());
+	stats.bytes_rx++;
+
+	if (xfer_lost) return 0xFF; //nobody drives SDA
+	return reg_read(ptr++);
+}
+
+void mmc_sim_stop(void)
+{
+	advance(period_ns());
+	stats.stops++;
+	bus_held = 0;
+	update_all();
+}
+
+/********************** time and statistics *************************/
+u64 mmc_sim_time_ns(void)
+{
+	return now_ns;
+}
+
+void mmc_sim_idle(u64 ns)
+{
+	now_ns += ns;
+	update_all();
+}
+
+mmc_sim_stats *mmc_sim_get_stats(void)
+{
+	return &stats;
+}
+
+u64 mmc_sim_elapsed_ns(void)
+{
+	return now_ns - stats_t0_ns;
+}
+
+void mmc_sim_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	stats_t0_ns = now_ns;
+}
+
+void mmc_sim_print_stats(const char *title)
+{
+	printf("%s @ %u Hz\n", title, scl_hz);
+	printf("  START %u (repeated %u), STOP %u, NACK %u\n", stats.starts, stats.rstarts, stats.stops, stats.nacks);
+	printf("  bytes: address %u, written %u, read %u\n", stats.addr_bytes, stats.bytes_tx, stats.bytes_rx);
+	printf("  commands %u (dropped %u)\n", stats.cmds, stats.cmds_dropped);
+	printf("  bus time %.3f ms (stretched %.3f ms), elapsed %.3f ms\n", stats.bus_ns / 1e6, stats.stretch_ns / 1e6,
+	       (now_ns - stats_t0_ns) / 1e6);
+}
+
+/********************** backdoor *************************/
+u8 *mmc_sim_flash(void)
+{
+	return sel->flash;
+}
+
+u8 *mmc_sim_sd(void)
+{
+	return sel->sd;
+}
+
+void mmc_sim_load_file(u8 id, const u8 *data, u32 len)
+{
+	u32 info = info_addr(id);
+
+	memset(sel->flash + id * FLASH_FILE_SIZE, 0xFF, FLASH_FILE_SIZE);
+	memcpy(sel->flash + id * FLASH_FILE_SIZE, data, len);
+	memset(sel->flash + info, 0xFF, FLASH_SECTOR_SIZE);
+	put32(sel->flash + info + 4, len);
+	put32(sel->flash + info + 8, mmc_sim_crc32(data, len));
+}
@@ -0,0 +1,87 @@
+/*
+ * Info   : Host model of the GPAC3 MMC as seen from its I2C slave port.
+ *          Implements the register map used by mmc.c (command block at
+ *          0x800/0x900, flash buffers at 0x1000/0x1100), a 16 MiB flash with
+ *          64 KiB erase sectors, an SD card (a 512 byte sector keeps both
+ *          halves only if they are programmed one after the other, lower
+ *          half first), the info section and the WRLEN/CRC commands. Bus
+ *          conditions, bytes and the wire time at the configured SCL rate
+ *          are counted so transfers can be benchmarked. Several MMCs can
+ *          share the bus, each with its own storage and command state.
+ */
+
+#ifndef MMC_SIM_H
+#define MMC_SIM_H
+
+#include <xil_types.h>
+
+#define MMC_SIM_FLASH_SIZE 0x1000000 //16MiB
+#define MMC_SIM_SD_SIZE    0x1000000 //16MiB modelled, the real card is larger
+#define MMC_SIM_DEVS       4         //MMCs the model can put on the bus, at MMC_I2C_ADDR7 and the next addresses
+
+/* result codes stored in the lower half of the command result register */
+#define MMC_SIM_RES_OK      0x0000
+#define MMC_SIM_RES_EADDR   0x0001 //address out of range or misaligned
+#define MMC_SIM_RES_ELOCKED 0x0002 //protected command without valid secure key
+#define MMC_SIM_RES_ELEN    0x0003 //file length missing or too big
+#define MMC_SIM_RES_EUNKNOWN 0x00FF //unknown command code
+
+typedef struct {
+	u32 starts;      //START conditions, repeated STARTs included
+	u32 rstarts;     //repeated START conditions
+	u32 stops;       //STOP conditions
+	u32 addr_bytes;  //slave address bytes
+	u32 bytes_tx;    //data bytes written to the slave
+	u32 bytes_rx;    //data bytes read from the slave
+	u32 nacks;       //address bytes not acknowledged
+	u32 cmds;        //commands executed
+	u32 cmds_dropped;//commands written while the MMC was busy (no clock stretching only)
+	u64 bus_ns;      //modelled time the bus was in use, stretching included
+	u64 stretch_ns;  //part of bus_ns where the MMC held SCL low
+} mmc_sim_stats;
+
+typedef struct {
+	u32 fread_ns;
+	u32 fprog_ns;
+	u32 ferase_ns;
+	u32 sdread_ns;
+	u32 sdprog_ns;
+	u32 wrlen_ns;
+	u32 crc_ns_per_kib;
+	u32 reboot_ns;   //RESET, IAP and TSD
+} mmc_sim_latency;
+
+/* model setup */
+void mmc_sim_init(u32 scl_hz);
+void mmc_sim_set_scl(u32 scl_hz);
+u32  mmc_sim_get_scl(void);
+void mmc_sim_set_stretch(int on);
+void mmc_sim_set_max_scl(u32 scl_hz);  //above this rate the MMC loses the data bits after its address, 0: no limit
+mmc_sim_latency *mmc_sim_latencies(void);
+void mmc_sim_reset_after(u32 ncmds); //the MMC resets itself at the NCMDS-th next command
+void mmc_sim_set_devices(u32 n);     //N MMCs answer on the bus (1 after mmc_sim_init), the new ones are blank
+void mmc_sim_select(u32 k);          //the MMC at MMC_I2C_ADDR7+K is the one of the setup and backdoor calls
+
+/* bus primitives, one call per bus condition or byte */
+int  mmc_sim_start(u8 addr7, int read); //returns 1 if the address is acknowledged
+int  mmc_sim_write(u8 data);            //returns 1 if the byte is acknowledged
+u8   mmc_sim_read(int ack);
+void mmc_sim_stop(void);
+
+/* model time */
+u64  mmc_sim_time_ns(void);
+void mmc_sim_idle(u64 ns);
+
+/* statistics */
+mmc_sim_stats *mmc_sim_get_stats(void);
+void mmc_sim_reset_stats(void);
+u64  mmc_sim_elapsed_ns(void); //model time since the last mmc_sim_reset_stats()
+void mmc_sim_print_stats(const char *title);
+
+/* backdoor access to the storage */
+u8  *mmc_sim_flash(void);
+u8  *mmc_sim_sd(void);
+u32  mmc_sim_crc32(const u8 *buf, u32 n);
+void mmc_sim_load_file(u8 id, const u8 *data, u32 len);
+
+#endif // MMC_SIM_H
@@ -0,0 +1,116 @@
+/*
+ * Info   : Greedy patch generator (see patch_enc.h): the old file is indexed by
+ *          the hash of every 8 byte string, the first position is kept. At each
+ *          new position the old position following the last copy is tried first
+ *          (edits that do not move the code), then the hash table.
+ */
+
+#include <string.h>
+#include "patch_enc.h"
+#include "patch.h"
+#include "crc32.h"
+
+#define HASH_BITS 16
+#define KEY_LEN   8
+#define MIN_COPY  16 //a shorter COPY costs more than inserting the bytes
+
+static u32 table[1 << HASH_BITS]; //old position + 1, 0 if none
+
+static u32 hash8(const u8 *p)
+{
+	u32 a = p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+	u32 b = p[4] | (p[5] << 8) | (p[6] << 16) | ((u32)p[7] << 24);
+
+	return ((a * 2654435761U) ^ (b * 2246822519U)) >> (32 - HASH_BITS);
+}
+
+static u8 *put32(u8 *op, u32 v)
+{
+	*op++ = v >> 24;
+	*op++ = v >> 16;
+	*op++ = v >> 8;
+	*op++ = v;
+	return op;
+}
+
+static u8 *put_insert(u8 *op, const u8 *p, u32 n)
+{
+	u32 k;
+
+	for (; n; n -= k, p += k) {
+		k = (n > 0xFFFF) ? 0xFFFF : n;
+		*op++ = PATCH_OP_INSERT;
+		*op++ = k >> 8;
+		*op++ = k;
+		memcpy(op, p, k);
+		op += k;
+	}
+	return op;
+}
+
+static u8 *put_copy(u8 *op, u32 offset, u32 len)
+{
+	*op++ = PATCH_OP_COPY;
+	*op++ = offset >> 16;
+	*op++ = offset >> 8;
+	*op++ = offset;
+	*op++ = len >> 16;
+	*op++ = len >> 8;
+	*op++ = len;
+	return op;
+}
+
+static u32 match_len(const u8 *old, u32 old_n, u32 o, const u8 *new, u32 new_n, u32 i)
+{
+	u32 n = 0;
+
+	while (o + n < old_n && i + n < new_n && old[o + n] == new[i + n]) n++;
+	return n;
+}
+
+u32 patch_make(const u8 *old, u32 old_n, const u8 *new, u32 new_n, u8 *out)
+{
+	u8 *op = out;
+	u32 i, h, o, len, best, best_o = 0, next_o = 0, ins = 0;
+
+	memset(table, 0, sizeof(table));
+	for (i = 0; i + KEY_LEN <= old_n; i++) {
+		h = hash8(old + i);
+		if (!table[h]) table[h] = i + 1;
+	}
+
+	op = put32(op, PATCH_MAGIC);
+	op = put32(op, old_n);
+	op = put32(op, crc32_update(0, old, old_n));
+	op = put32(op, new_n);
+	op = put32(op, crc32_update(0, new, new_n));
+
+	for (i = 0; i < new_n; ) {
+		best = 0;
+		if (next_o < old_n) {
+			best   = match_len(old, old_n, next_o, new, new_n, i);
+			best_o = next_o;
+		}
+		if (best < MIN_COPY && i + KEY_LEN <= new_n && (o = table[hash8(new + i)])) {
+			len = match_len(old, old_n, o - 1, new, new_n, i);
+			if (len > best) {
+				best   = len;
+				best_o = o - 1;
+			}
+		}
+		if (best < MIN_COPY) {
+			i++;
+			next_o++;
+			continue;
+		}
+		op = put_insert(op, new + ins, i - ins);
+		op = put_copy(op, best_o, best);
+		i     += best;
+		ins    = i;
+		next_o = best_o + best;
+	}
+	op = put_insert(op, new + ins, i - ins);
+	*op++ = PATCH_OP_END;
+
+	return op - out;
+}
@@ -0,0 +1,17 @@
+/*
+ * Info   : Host side binary patch generator producing the patches applied by patch.c.
+ */
+
+#ifndef PATCH_ENC_H
+#define PATCH_ENC_H
+
+#include <xil_types.h>
+
+/* Make the patch from OLD (OLD_N bytes) to NEW (NEW_N bytes) into OUT, that
+ * shall hold at least NEW_N + NEW_N/256 + 32 bytes
+ *
+ *  returns: the patch size
+ */
+u32 patch_make(const u8 *old, u32 old_n, const u8 *new, u32 new_n, u8 *out);
+
+#endif // PATCH_ENC_H
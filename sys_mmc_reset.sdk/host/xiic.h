@@ -0,0 +1,57 @@
+/*
+ * Info   : Host replacement for the iic driver's interrupt driven API (xiic.h).
+ *          XIic_MasterSend/XIic_MasterRecv run the whole transaction on the
+ *          MMC model at once. Its completion interrupt comes with the next
+ *          xiic_sim_interrupt(), called by the host spin_us() of the waits
+ *          (see xiic_sim.c). A start from a handler right after a STOP finds
+ *          the bus busy and gets the bus not busy event, like on the core.
+ */
+
+#ifndef XIIC_H
+#define XIIC_H
+
+#include "xil_types.h"
+#include "xstatus.h"
+#include "xiic_l.h"
+
+#define XII_REPEATED_START_OPTION 0x00000002
+#define XII_ADDR_TO_SEND_TYPE     1
+
+#define XII_BUS_NOT_BUSY_EVENT    0x01
+#define XII_ARB_LOST_EVENT        0x02
+#define XII_SLAVE_NO_ACK_EVENT    0x04
+
+typedef void (*XIic_Handler)(void *CallBackRef, int ByteCount);
+typedef void (*XIic_StatusHandler)(void *CallBackRef, int StatusEvent);
+
+typedef struct {
+	u32 Options;
+	u8  AddrOfSlave;
+	void *SendCallBackRef;
+	void *RecvCallBackRef;
+	void *StatusCallBackRef;
+	XIic_Handler SendHandler;
+	XIic_Handler RecvHandler;
+	XIic_StatusHandler StatusHandler;
+} XIic;
+
+int  XIic_Initialize(XIic *InstancePtr, u16 DeviceId);
+int  XIic_Start(XIic *InstancePtr);
+int  XIic_SetAddress(XIic *InstancePtr, int AddressType, int Address);
+int  XIic_SetOptions(XIic *InstancePtr, u32 Options);
+u32  XIic_GetOptions(XIic *InstancePtr);
+void XIic_SetSendHandler(XIic *InstancePtr, void *CallBackRef, XIic_Handler FuncPtr);
+void XIic_SetRecvHandler(XIic *InstancePtr, void *CallBackRef, XIic_Handler FuncPtr);
+void XIic_SetStatusHandler(XIic *InstancePtr, void *CallBackRef, XIic_StatusHandler FuncPtr);
+int  XIic_MasterSend(XIic *InstancePtr, u8 *TxMsgPtr, int ByteCount);
+int  XIic_MasterRecv(XIic *InstancePtr, u8 *RxMsgPtr, int ByteCount);
+void XIic_InterruptHandler(void *InstancePtr);
+
+/* host model only: deliver the interrupt of the finished transaction, if any */
+void xiic_sim_interrupt(void);
+/* host model only: the bus stays busy, the starts fail and no bus not busy event comes */
+void xiic_sim_set_hang(int on);
+/* returns: number of starts that found the bus busy */
+u32 xiic_sim_bus_busy(void);
+
+#endif // XIIC_H
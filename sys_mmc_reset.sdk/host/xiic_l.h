@@ -0,0 +1,71 @@
+/*
+ * Info   : Host replacement for the iic driver's xiic_l.h.
+ *          XIic_Send/XIic_Recv are implemented in xiic_sim.c on top of the
+ *          MMC model (mmc_sim.c) instead of the AXI IIC registers.
+ *          XIic_ReadReg/XIic_WriteReg access the register model of the
+ *          AXI IIC core in iic_sim.c.
+ */
+
+#ifndef XIIC_L_H
+#define XIIC_L_H
+
+#include "xil_types.h"
+
+#define XIIC_STOP           0x00
+#define XIIC_REPEATED_START 0x01
+
+#define XIIC_WRITE_OPERATION 0
+#define XIIC_READ_OPERATION  1
+
+/* register offsets */
+#define XIIC_DGIER_OFFSET    0x1C
+#define XIIC_IISR_OFFSET     0x20
+#define XIIC_IIER_OFFSET     0x28
+#define XIIC_RESETR_OFFSET   0x40
+#define XIIC_CR_REG_OFFSET   0x100
+#define XIIC_SR_REG_OFFSET   0x104
+#define XIIC_DTR_REG_OFFSET  0x108
+#define XIIC_DRR_REG_OFFSET  0x10C
+#define XIIC_ADR_REG_OFFSET  0x110
+#define XIIC_TFO_REG_OFFSET  0x114
+#define XIIC_RFO_REG_OFFSET  0x118
+#define XIIC_TBA_REG_OFFSET  0x11C
+#define XIIC_RFD_REG_OFFSET  0x120
+#define XIIC_GPO_REG_OFFSET  0x124
+
+#define XIIC_RESET_MASK      0x0000000A
+
+/* control register */
+#define XIIC_CR_ENABLE_DEVICE_MASK  0x00000001
+#define XIIC_CR_TX_FIFO_RESET_MASK  0x00000002
+#define XIIC_CR_MSMS_MASK           0x00000004
+#define XIIC_CR_DIR_IS_TX_MASK      0x00000008
+#define XIIC_CR_NO_ACK_MASK         0x00000010
+#define XIIC_CR_REPEATED_START_MASK 0x00000020
+
+/* status register */
+#define XIIC_SR_BUS_BUSY_MASK       0x00000004
+#define XIIC_SR_TX_FIFO_FULL_MASK   0x00000010
+#define XIIC_SR_RX_FIFO_FULL_MASK   0x00000020
+#define XIIC_SR_RX_FIFO_EMPTY_MASK  0x00000040
+#define XIIC_SR_TX_FIFO_EMPTY_MASK  0x00000080
+
+/* interrupt status register */
+#define XIIC_INTR_ARB_LOST_MASK     0x00000001
+#define XIIC_INTR_TX_ERROR_MASK     0x00000002
+#define XIIC_INTR_TX_EMPTY_MASK     0x00000004
+#define XIIC_INTR_RX_FULL_MASK      0x00000008
+#define XIIC_INTR_BNB_MASK          0x00000010
+#define XIIC_INTR_TX_HALF_MASK      0x00000080
+
+/* dynamic mode TX FIFO control bits */
+#define XIIC_TX_DYN_START_MASK      0x00000100
+#define XIIC_TX_DYN_STOP_MASK       0x00000200
+
+u32  XIic_ReadReg(UINTPTR BaseAddress, u32 RegOffset);
+void XIic_WriteReg(UINTPTR BaseAddress, u32 RegOffset, u32 RegisterValue);
+
+unsigned XIic_Send(UINTPTR BaseAddress, u8 Address, u8 *BufferPtr, unsigned ByteCount, u8 Option);
+unsigned XIic_Recv(UINTPTR BaseAddress, u8 Address, u8 *BufferPtr, unsigned ByteCount, u8 Option);
+
+#endif // XIIC_L_H
@@ -0,0 +1,198 @@
+/*
+ * Info   : Host implementation of the polled XIic_Send/XIic_Recv calls and
+ *          of the interrupt driven XIic_Master* API, driving the MMC model
+ *          instead of the AXI IIC core.
+ */
+
+#include "xiic_l.h"
+#include "xiic.h"
+#include "mmc_sim.h"
+
+static XIic *inst   = NULL;
+static int   depth   = 0; //inside XIic_InterruptHandler(): a start from there is in interrupt context
+static int   stopped = 0; //the last transaction ended with a STOP, the bus is busy until its bus free time
+static int   waiting = 0; //a start found the bus busy, the bus not busy interrupt is due
+static int   hang    = 0;
+static u32   busy    = 0;
+
+/* completion interrupt of the transaction on the bus */
+static struct {
+	int pending;
+	int nack;
+	int remaining;
+	XIic_Handler handler;
+	void *ref;
+} due;
+
+unsigned XIic_Send(UINTPTR BaseAddress, u8 Address, u8 *BufferPtr, unsigned ByteCount, u8 Option)
+{
+	unsigned i;
+
+	(void)BaseAddress;
+	if (!mmc_sim_start(Address, 0)) {
+		mmc_sim_stop();
+		return 0;
+	}
+	for (i = 0; i < ByteCount; i++) {
+		if (!mmc_sim_write(BufferPtr[i])) break;
+	}
+	if (Option == XIIC_STOP) mmc_sim_stop();
+
+	return i;
+}
+
+unsigned XIic_Recv(UINTPTR BaseAddress, u8 Address, u8 *BufferPtr, unsigned ByteCount, u8 Option)
+{
+	unsigned i;
+
+	(void)BaseAddress;
+	if (!mmc_sim_start(Address, 1)) {
+		mmc_sim_stop();
+		return 0;
+	}
+	for (i = 0; i < ByteCount; i++) {
+		BufferPtr[i] = mmc_sim_read(i + 1 < ByteCount);
+	}
+	if (Option == XIIC_STOP) mmc_sim_stop();
+
+	return i;
+}
+
+/********************** interrupt driven API *************************/
+int XIic_Initialize(XIic *InstancePtr, u16 DeviceId)
+{
+	(void)DeviceId;
+	InstancePtr->Options = 0;
+	InstancePtr->AddrOfSlave = 0;
+	return XST_SUCCESS;
+}
+
+int XIic_Start(XIic *InstancePtr)
+{
+	(void)InstancePtr;
+	return XST_SUCCESS;
+}
+
+int XIic_SetAddress(XIic *InstancePtr, int AddressType, int Address)
+{
+	(void)AddressType;
+	InstancePtr->AddrOfSlave = Address;
+	return XST_SUCCESS;
+}
+
+int XIic_SetOptions(XIic *InstancePtr, u32 Options)
+{
+	InstancePtr->Options = Options;
+	return XST_SUCCESS;
+}
+
+u32 XIic_GetOptions(XIic *InstancePtr)
+{
+	return InstancePtr->Options;
+}
+
+void XIic_SetSendHandler(XIic *InstancePtr, void *CallBackRef, XIic_Handler FuncPtr)
+{
+	InstancePtr->SendCallBackRef = CallBackRef;
+	InstancePtr->SendHandler = FuncPtr;
+}
+
+void XIic_SetRecvHandler(XIic *InstancePtr, void *CallBackRef, XIic_Handler FuncPtr)
+{
+	InstancePtr->RecvCallBackRef = CallBackRef;
+	InstancePtr->RecvHandler = FuncPtr;
+}
+
+void XIic_SetStatusHandler(XIic *InstancePtr, void *CallBackRef, XIic_StatusHandler FuncPtr)
+{
+	InstancePtr->StatusCallBackRef = CallBackRef;
+	InstancePtr->StatusHandler = FuncPtr;
+}
+
+static u8 option(XIic *InstancePtr)
+{
+	return (InstancePtr->Options & XII_REPEATED_START_OPTION) ? XIIC_REPEATED_START : XIIC_STOP;
+}
+
+/* the driver refuses a start while the bus is busy and enables the bus not
+ * busy interrupt: from a handler the STOP just sent is still on the bus
+ *
+ *  returns: 1 if the bus is busy
+ */
+static int bus_busy(void)
+{
+	if (!hang && !(depth && stopped)) return 0;
+	waiting = !hang;
+	busy++;
+	return 1;
+}
+
+/* the transaction runs on the model at once, its interrupt is due */
+static void started(XIic *InstancePtr, unsigned n, int ByteCount, XIic_Handler handler, void *ref)
+{
+	inst    = InstancePtr;
+	stopped = (option(InstancePtr) == XIIC_STOP);
+	due.handler   = handler;
+	due.ref       = ref;
+	due.remaining = ByteCount - n;
+	due.nack      = (n == 0 && ByteCount != 0);
+	due.pending   = 1;
+}
+
+int XIic_MasterSend(XIic *InstancePtr, u8 *TxMsgPtr, int ByteCount)
+{
+	unsigned n;
+
+	if (bus_busy()) return XST_IIC_BUS_BUSY;
+	n = XIic_Send(0, InstancePtr->AddrOfSlave, TxMsgPtr, ByteCount, option(InstancePtr));
+	started(InstancePtr, n, ByteCount, InstancePtr->SendHandler, InstancePtr->SendCallBackRef);
+	return XST_SUCCESS;
+}
+
+int XIic_MasterRecv(XIic *InstancePtr, u8 *RxMsgPtr, int ByteCount)
+{
+	unsigned n;
+
+	if (bus_busy()) return XST_IIC_BUS_BUSY;
+	n = XIic_Recv(0, InstancePtr->AddrOfSlave, RxMsgPtr, ByteCount, option(InstancePtr));
+	started(InstancePtr, n, ByteCount, InstancePtr->RecvHandler, InstancePtr->RecvCallBackRef);
+	return XST_SUCCESS;
+}
+
+/* the completion interrupt of the running transaction, then the bus not busy
+ * interrupt if a start from the handler found the bus busy */
+void XIic_InterruptHandler(void *InstancePtr)
+{
+	XIic *iic = InstancePtr;
+
+	if (!due.pending) return;
+	due.pending = 0;
+	depth++;
+	if (due.nack) {
+		iic->StatusHandler(iic->StatusCallBackRef, XII_SLAVE_NO_ACK_EVENT);
+	} else {
+		due.handler(due.ref, due.remaining);
+	}
+	if (waiting) {
+		waiting = 0;
+		stopped = 0; //bus free time is over
+		iic->StatusHandler(iic->StatusCallBackRef, XII_BUS_NOT_BUSY_EVENT);
+	}
+	depth--;
+}
+
+void xiic_sim_interrupt(void)
+{
+	if (inst) XIic_InterruptHandler(inst);
+}
+
+void xiic_sim_set_hang(int on)
+{
+	hang = on;
+	waiting = 0;
+}
+
+u32 xiic_sim_bus_busy(void)
+{
+	return busy;
+}
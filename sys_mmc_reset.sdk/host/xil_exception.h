@@ -0,0 +1,23 @@
+/*
+ * Info   : Host replacement for the standalone BSP's xil_exception.h.
+ *          There are no interrupts on the host, all calls are no-ops.
+ */
+
+#ifndef XIL_EXCEPTION_H
+#define XIL_EXCEPTION_H
+
+#include "xil_types.h"
+
+#define XIL_EXCEPTION_ID_INT 0
+
+typedef void (*Xil_ExceptionHandler)(void *Data);
+
+static inline void Xil_ExceptionInit(void) {}
+static inline void Xil_ExceptionEnable(void) {}
+static inline void Xil_ExceptionDisable(void) {}
+static inline void Xil_ExceptionRegisterHandler(u32 Id, Xil_ExceptionHandler Handler, void *Data)
+{
+	(void)Id; (void)Handler; (void)Data;
+}
+
+#endif // XIL_EXCEPTION_H
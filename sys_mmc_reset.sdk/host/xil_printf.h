@@ -0,0 +1,12 @@
+/*
+ * Info   : Host replacement for the standalone BSP's xil_printf.h
+ */
+
+#ifndef XIL_PRINTF_H
+#define XIL_PRINTF_H
+
+#include <stdio.h>
+
+#define xil_printf printf
+
+#endif // XIL_PRINTF_H
@@ -0,0 +1,23 @@
+/*
+ * Info   : Host replacement for the BSP's generated xparameters.h.
+ *          Only the entries used by the sw application are provided,
+ *          with the values of the design_1 block design.
+ */
+
+#ifndef XPARAMETERS_H
+#define XPARAMETERS_H
+
+#define XPAR_AXI_GPIO_0_BASEADDR 0x10000000
+#define XPAR_AXI_IIC_0_BASEADDR  0x10100000
+#define XPAR_AXI_INTC_0_BASEADDR 0x10300000
+#define XPAR_MDM_1_BASEADDR      0x10200000
+#define STDIN_BASEADDRESS        XPAR_MDM_1_BASEADDR
+#define STDOUT_BASEADDRESS       XPAR_MDM_1_BASEADDR
+
+#define XPAR_CPU_CORE_CLOCK_FREQ_HZ 125000000
+
+#define XPAR_IIC_0_DEVICE_ID      0
+#define XPAR_INTC_0_DEVICE_ID     0
+#define XPAR_INTC_0_IIC_0_VEC_ID  0
+
+#endif // XPARAMETERS_H
@@ -0,0 +1,13 @@
+/*
+ * Info   : Host replacement for the standalone BSP's xstatus.h
+ */
+
+#ifndef XSTATUS_H
+#define XSTATUS_H
+
+#define XST_SUCCESS 0L
+#define XST_FAILURE 1L
+
+#define XST_IIC_BUS_BUSY 1102L
+
+#endif // XSTATUS_H
@@ -0,0 +1,17 @@
+/*
+ * Info   : Host replacement for the uartlite driver's xuartlite_l.h.
+ *          The mdm_1 console is implemented in console_sim.c on top of
+ *          the model of the PC.
+ */
+
+#ifndef XUARTLITE_L_H
+#define XUARTLITE_L_H
+
+#include "xil_types.h"
+
+int XUartLite_IsReceiveEmpty(u32 base_address);
+u8  XUartLite_RecvByte(u32 base_address);
+int XUartLite_IsTransmitFull(u32 base_address);
+void XUartLite_SendByte(u32 base_address, u8 data);
+
+#endif // XUARTLITE_L_H
@@ -0,0 +1,115 @@
+#include "console.h"
+#include <string.h>
+#include <xparameters.h>
+#include "xuartlite_l.h"
+#include "sched.h"
+#include "delay.h"
+
+static u8  rx[CONSOLE_RX_LEN];
+static u16 rx_head = 0;
+static u16 rx_len  = 0;
+static u8  raw     = 0;
+
+static u8  tx[CONSOLE_TX_LEN];
+static u16 tx_head = 0;
+static u16 tx_len  = 0;
+
+/* move the transmit ring into the UART FIFO, as far as it has room */
+static void tx_drain(void)
+{
+	while (tx_len && !XUartLite_IsTransmitFull(STDOUT_BASEADDRESS)) {
+		XUartLite_SendByte(STDOUT_BASEADDRESS, tx[tx_head]);
+		tx_head = (tx_head + 1) % CONSOLE_TX_LEN;
+		tx_len--;
+	}
+}
+
+/* wait for room for N bytes in the transmit ring */
+static void tx_room(u16 n)
+{
+	for (;;) {
+		tx_drain();
+		if (CONSOLE_TX_LEN - tx_len >= n) break;
+		wait_us(CONSOLE_IDLE_US);
+	}
+}
+
+void console_poll(void)
+{
+	u8 c;
+
+	tx_drain();
+
+	/* a full ring leaves the bytes in the UART: the sender is held back, nothing is lost */
+	while (rx_len < CONSOLE_RX_LEN && !XUartLite_IsReceiveEmpty(STDIN_BASEADDRESS)) {
+		c = XUartLite_RecvByte(STDIN_BASEADDRESS);
+		if (c == CONSOLE_CANCEL && !raw) {
+			sched_cancel();
+		} else {
+			rx[(rx_head + rx_len) % CONSOLE_RX_LEN] = c;
+			rx_len++;
+		}
+	}
+}
+
+char console_getc(void)
+{
+	char c;
+
+	for (;;) {
+		console_poll();
+		if (rx_len) break;
+		sched_run();
+		wait_us(CONSOLE_IDLE_US);
+	}
+
+	c = rx[rx_head];
+	rx_head = (rx_head + 1) % CONSOLE_RX_LEN;
+	rx_len--;
+
+	return c;
+}
+
+void console_raw(int on)
+{
+	raw = on ? 1 : 0;
+}
+
+void outbyte(char c)
+{
+	if (tx_len == CONSOLE_TX_LEN) tx_room(1);
+	tx[(tx_head + tx_len) % CONSOLE_TX_LEN] = c;
+	tx_len++;
+}
+
+void console_write(const char *s, u16 n)
+{
+	u16 k, tail;
+
+	/* larger than the ring: in pieces */
+	for (; n; n -= k, s += k) {
+		k = (n > CONSOLE_TX_LEN) ? CONSOLE_TX_LEN : n;
+		tx_room(k);
+		tail = (tx_head + tx_len) % CONSOLE_TX_LEN;
+		if (tail + k > CONSOLE_TX_LEN) {
+			memcpy(tx + tail, s, CONSOLE_TX_LEN - tail);
+			memcpy(tx, s + CONSOLE_TX_LEN - tail, k - (CONSOLE_TX_LEN - tail));
+		} else {
+			memcpy(tx + tail, s, k);
+		}
+		tx_len += k;
+	}
+}
+
+u16 console_tx_free(void)
+{
+	return CONSOLE_TX_LEN - tx_len;
+}
+
+void console_flush(void)
+{
+	while (tx_len) {
+		tx_drain();
+		if (tx_len) wait_us(CONSOLE_IDLE_US);
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ * Info   : Console input and output through a receive and a transmit ring.
+ *
+ * The mdm_1 UART has no interrupt line in the design: console_poll() moves
+ * the received bytes into the receive ring. It runs as a scheduler task, so the keys
+ * typed during a job are kept for the menu, and console_getc() runs the
+ * scheduler while it waits. Ctrl-C cancels the running job instead of being
+ * stored, except in raw mode (binary uploads). A full ring leaves the bytes
+ * in the UART FIFO.
+ *
+ * outbyte() replaces the one of the BSP, so xil_printf() and the binary
+ * frames go to the transmit ring. console_poll() also moves the ring into
+ * the UART FIFO as far as it has room, so the printing CPU does not wait for
+ * the JTAG link while the MMC is busy. Only a full ring makes outbyte() wait.
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <xil_types.h>
+
+#define CONSOLE_RX_LEN  64   //receive ring, the UART FIFO holds 16 bytes
+#define CONSOLE_TX_LEN  2048 //transmit ring, holds a full menu or a displayed page
+#define CONSOLE_CANCEL  0x03 //Ctrl-C
+#define CONSOLE_IDLE_US 10   //wait between two polls of an empty receive or a full transmit FIFO
+
+/* move the bytes received by the UART into the receive ring and the transmit ring into the UART */
+void console_poll(void);
+
+/* returns: the next received byte, waits for it */
+char console_getc(void);
+
+/* raw mode: every byte goes to the ring, Ctrl-C included */
+void console_raw(int on);
+
+/* queue C for transmission, waits only while the ring is full */
+void outbyte(char c);
+
+/* queue the N bytes of S for transmission */
+void console_write(const char *s, u16 n);
+
+/* returns: free bytes in the transmit ring */
+u16 console_tx_free(void);
+
+/* wait until every queued byte is in the UART, e.g. before the system goes down */
+void console_flush(void);
+
+#endif // CONSOLE_H
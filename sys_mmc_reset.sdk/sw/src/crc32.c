@@ -0,0 +1,48 @@
+#include "crc32.h"
+
+#define CRC32_POLY 0xEDB88320
+
+static u32 table[4][256];
+static u8  table_ready = 0;
+
+static void make_table(void)
+{
+	u32 i, c;
+	int b;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (b = 0; b < 8; b++) {
+			c = (c >> 1) ^ ((c & 1) ? CRC32_POLY : 0);
+		}
+		table[0][i] = c;
+	}
+
+	/* table[k][i]: CRC of byte i followed by k zero bytes */
+	for (i = 0; i < 256; i++) {
+		c = table[0][i];
+		for (b = 1; b < 4; b++) {
+			c = (c >> 8) ^ table[0][c & 0xFF];
+			table[b][i] = c;
+		}
+	}
+
+	table_ready = 1;
+}
+
+u32 crc32_update(u32 crc, const u8 *buf, u32 n)
+{
+	if (!table_ready) make_table();
+
+	crc = ~crc;
+	for (; n >= 4; n -= 4, buf += 4) {
+		crc ^= buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((u32)buf[3] << 24);
+		crc = table[3][crc & 0xFF] ^ table[2][(crc >> 8) & 0xFF] ^
+		      table[1][(crc >> 16) & 0xFF] ^ table[0][crc >> 24];
+	}
+	for (; n; n--, buf++) {
+		crc = (crc >> 8) ^ table[0][(crc ^ *buf) & 0xFF];
+	}
+
+	return ~crc;
+}
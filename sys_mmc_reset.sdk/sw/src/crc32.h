@@ -0,0 +1,25 @@
+/*
+ * Info   : Table driven CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320,
+ *          initial value and final XOR 0xFFFFFFFF).
+ *          Assumed to be the CRC that the MMC computes with MMC_CMD_CRC: only
+ *          the host model (mmc_sim.c) says so, it is not verified on hardware.
+ *          Until it is, the file copies report a difference as a warning and
+ *          rely on the MMC's own CRC. An upload (upload.c) has no other
+ *          end-to-end check and still fails on a difference.
+ *          Slice-by-4: four 256 entry tables (4KiB of BRAM), built on the
+ *          first call, process 4 bytes per step.
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <xil_types.h>
+
+/* Continue the CRC of a byte stream with N more bytes from BUF
+ *  CRC: CRC of the bytes processed so far, 0 before the first call
+ *
+ *  returns: CRC of all the bytes processed so far
+ */
+u32 crc32_update(u32 crc, const u8 *buf, u32 n);
+
+#endif // CRC32_H
@@ -0,0 +1,67 @@
+#include "delay.h"
+#include <assert.h>
+
+static u32 now_us = 0;
+static u32 now_ns = 0; //part of the current microsecond already passed
+
+/* spin N iterations of DELAY_LOOP_CYCLES cycles, whatever the compiler flags */
+static void spin(u32 n)
+{
+	if (n == 0) return;
+	__asm__ volatile (
+		"1:	bneid	%0, 1b\n\t"
+		"	addik	%0, %0, -1\n\t"
+		: "+d" (n) : : "memory");
+}
+
+void wait_us(u32 n)
+{
+	assert(n < ((u32) -1) / DELAY_CYCLES_PER_US);
+	spin((n * DELAY_CYCLES_PER_US) / DELAY_LOOP_CYCLES);
+	now_us += n;
+}
+
+void wait_ms(u32 n)
+{
+	u32 i = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		wait_us(1000);
+	}
+}
+
+void wait_s(u32 n)
+{
+	u32 i = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		wait_ms(1000);
+	}
+}
+
+u32 time_now_us(void)
+{
+	return now_us;
+}
+
+void wait_until_us(u32 deadline)
+{
+	if (time_before(now_us, deadline)) wait_us(deadline - now_us);
+}
+
+void spin_us(u32 n)
+{
+	assert(n < ((u32) -1) / DELAY_CYCLES_PER_US);
+	spin((n * DELAY_CYCLES_PER_US) / DELAY_LOOP_CYCLES);
+}
+
+void time_advance_ns(u32 ns)
+{
+	now_ns += ns;
+	if (now_ns >= 1000) {
+		now_us += now_ns / 1000;
+		now_ns %= 1000;
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ * Info   : Timebase and busy-wait delays.
+ *
+ * The design has no timer: the waits spin a loop of known length in CPU
+ * cycles, calibrated with the MicroBlaze clock (FREQ_HZ of the block design),
+ * and a software clock counts the time spent in them. The bus layer adds the
+ * wire time of every transaction (time_advance_ns()), so time_now_us() follows
+ * the time spent waiting for the MMC. CPU work between the waits and the
+ * transactions is not seen, interrupts taken while spinning lengthen the wait.
+ *
+ * Timestamps are microseconds and wrap after about 71 minutes: compare them
+ * with time_before() only.
+ */
+
+#ifndef DELAY_H
+#define DELAY_H
+
+#include <xil_types.h>
+#include <xparameters.h>
+
+#ifndef XPAR_CPU_CORE_CLOCK_FREQ_HZ
+#define XPAR_CPU_CORE_CLOCK_FREQ_HZ 125000000
+#endif
+
+#define DELAY_CYCLES_PER_US (XPAR_CPU_CORE_CLOCK_FREQ_HZ / 1000000)
+
+/* CPU cycles of one iteration of the wait loop: a taken bneid with the decrement
+ * in its delay slot (5-stage pipeline, C_AREA_OPTIMIZED=0, code in LMB BRAM) */
+#ifndef DELAY_LOOP_CYCLES
+#define DELAY_LOOP_CYCLES 2
+#endif
+
+/* 1 if the timestamp A is before B */
+#define time_before(a, b) ((s32)((u32)(a) - (u32)(b)) < 0)
+
+void wait_us(u32 n);
+void wait_ms(u32 n);
+void wait_s(u32 n);
+
+/* returns: the current timestamp in microseconds */
+u32 time_now_us(void);
+
+/* wait until the timestamp DEADLINE, return at once if it is already past */
+void wait_until_us(u32 deadline);
+
+/* account NS nanoseconds that passed outside the waits (e.g. on the bus) */
+void time_advance_ns(u32 ns);
+
+/* busy-wait N microseconds without advancing the timebase, for waits whose
+ * time is already accounted (e.g. the wire time of a queued transaction) */
+void spin_us(u32 n);
+
+#endif // DELAY_H
@@ -0,0 +1,163 @@
+#include "dump.h"
+#include "xil_printf.h"
+#include "mmc.h"
+#include "sd.h"
+#include "crc32.h"
+#include "upload.h"
+#include "sched.h"
+#include "console.h"
+
+#define PAGE     MMC_FLASH_BUF_LEN
+#define HEX_LEN  32 //data bytes per Intel HEX record
+#define NO_ADR   0xFFFFFFFF
+
+static const char hex_digit[] = "0123456789ABCDEF";
+
+static u32 ra_adr = NO_ADR; //flash page being read ahead
+static u32 end_adr;         //end of the dumped range
+static u32 hex_seg;         //upper 16 bits of the address in the last extended linear address record
+
+/* read the flash page at ADR into BUF, then start reading the next one if it is in the range
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int flash_read(u32 adr, u8 *buf)
+{
+	u32 res;
+
+	if (ra_adr == adr) {
+		res = mmc_wait_cmd_res(MMC_CMD_FREAD);
+	} else {
+		mmc_set_addr(adr);
+		res = mmc_run_cmd(MMC_CMD_FREAD);
+	}
+	ra_adr = NO_ADR;
+	if (res & 0xFFFF) {
+		xil_printf("\n\rdump_range()::ERROR::Could not read FLASH address 0x%08X\n\r", adr);
+		return 1;
+	}
+	mmc_get_buffer(buf, PAGE);
+
+	if (adr + PAGE < end_adr) {
+		mmc_set_addr(adr + PAGE);
+		mmc_start_cmd(MMC_CMD_FREAD);
+		ra_adr = adr + PAGE;
+	}
+	return 0;
+}
+
+static char *put_hex(char *p, u8 c, u8 *sum)
+{
+	*p++ = hex_digit[c >> 4];
+	*p++ = hex_digit[c & 0xF];
+	*sum += c;
+	return p;
+}
+
+/* send one Intel HEX record: LEN bytes of DATA of type TYPE at ADR (lower 16 bits) */
+static void hex_record(u8 type, u16 adr, const u8 *data, u8 len)
+{
+	char line[1 + 2 * (5 + HEX_LEN) + 2], *p = line; //the record is formatted, then queued at once
+	u8 sum = 0, i;
+
+	*p++ = ':';
+	p = put_hex(p, len, &sum);
+	p = put_hex(p, adr >> 8, &sum);
+	p = put_hex(p, adr, &sum);
+	p = put_hex(p, type, &sum);
+	for (i = 0; i < len; i++) p = put_hex(p, data[i], &sum);
+	p = put_hex(p, -sum, &sum);
+	*p++ = '\r';
+	*p++ = '\n';
+	console_write(line, p - line);
+}
+
+/* send N bytes of BUF at ADR as Intel HEX data records, records do not cross 64KiB */
+static void hex_data(u32 adr, const u8 *buf, u32 n)
+{
+	u8  ela[2];
+	u32 k;
+
+	for (; n; n -= k, adr += k, buf += k) {
+		if ((adr >> 16) != hex_seg) {
+			hex_seg = adr >> 16;
+			ela[0] = adr >> 24;
+			ela[1] = adr >> 16;
+			hex_record(0x04, 0, ela, 2);
+		}
+		k = HEX_LEN - (adr % HEX_LEN);
+		if (k > n) k = n;
+		hex_record(0x00, adr, buf, k);
+	}
+}
+
+/* send N bytes of BUF as a binary frame with sequence number SEQ */
+static void bin_frame(u8 seq, const u8 *buf, u16 n)
+{
+	u8  hdr[3];
+	u32 crc;
+	u16 i;
+
+	hdr[0] = seq;
+	hdr[1] = n >> 8;
+	hdr[2] = n;
+	crc = crc32_update(crc32_update(0, hdr, 3), buf, n);
+
+	outbyte(UPLOAD_SOF);
+	for (i = 0; i < 3; i++) outbyte(hdr[i]);
+	console_write((const char *)buf, n);
+	for (i = 0; i < 4; i++) outbyte(crc >> (24 - 8 * i));
+}
+
+int dump_range(u32 adr, u32 len, u8 flags)
+{
+	static u8 buf[PAGE] __attribute__((aligned(4))); //not on the 1KiB stack
+	u8  seq = 0;
+	u32 k;
+	int ret = 0;
+
+	end_adr = adr + len;
+	ra_adr  = NO_ADR;
+	hex_seg = NO_ADR;
+	sched_job_begin(NULL, len); //the console carries the dump: no progress report
+
+	/* one page, or up to the next page boundary, at a time: the reads stay page aligned */
+	for (; len; len -= k, adr += k) {
+		if (sched_cancelled()) {
+			ret = 1;
+			break;
+		}
+		k = PAGE - (adr % PAGE);
+		if (k > len) k = len;
+
+		if (flags & DUMP_SD) {
+			ret = sd_read(adr, buf, k);
+		} else {
+			ret = flash_read(adr & ~(PAGE - 1), buf);
+		}
+		if (ret) break;
+
+		if (flags & DUMP_BIN) {
+			bin_frame(seq++, (flags & DUMP_SD) ? buf : buf + adr % PAGE, k);
+		} else {
+			hex_data(adr, (flags & DUMP_SD) ? buf : buf + adr % PAGE, k);
+		}
+	}
+
+	if (ra_adr != NO_ADR) mmc_wait_cmd_res(MMC_CMD_FREAD);
+	if ((flags & DUMP_SD) && sd_flush()) ret = 1;
+	sched_job_end();
+	if (ret) {
+		if (flags & DUMP_BIN) outbyte(UPLOAD_CAN);
+		console_flush();
+		return 1;
+	}
+
+	if (flags & DUMP_BIN) {
+		bin_frame(seq, buf, 0);
+	} else {
+		hex_record(0x01, 0, buf, 0);
+	}
+	console_flush(); //done when the PC has it all
+	return 0;
+}
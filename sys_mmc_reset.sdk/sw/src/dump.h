@@ -0,0 +1,30 @@
+/*
+ * Info   : Bulk export of a flash or SD card range to the mdm_1 console.
+ *
+ * Two formats:
+ *  - Intel HEX: 32 data bytes per record, an extended linear address record
+ *    before each 64 KiB, the end of file record at the end. Plain text, can
+ *    be captured with any terminal.
+ *  - binary frames as in upload.h (SOF | SEQ | LEN | DATA | CRC), 256 data
+ *    bytes per frame, a frame with LEN = 0 at the end. Nothing is acknowledged:
+ *    the PC checks the CRCs and asks again for the range of a bad frame.
+ *
+ * The MMC reads the next page while the current one is being sent.
+ */
+
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <xil_types.h>
+
+/* dump_range() flags */
+#define DUMP_SD  0x01 //read the SD card instead of the flash
+#define DUMP_BIN 0x02 //binary frames instead of Intel HEX
+
+/* send LEN bytes starting at address ADR of the flash or of the SD card to the console
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int dump_range(u32 adr, u32 len, u8 flags);
+
+#endif // DUMP_H
@@ -1,5 +1,6 @@
 #include "gpio.h"
 #include <assert.h>
+#include "delay.h"
 
 u32 gpio_reg_cache = 0;
 gpio_bit led_r_green = {GPIO_REG, 0, &gpio_reg_cache};
@@ -54,14 +55,8 @@ void gpio_toggle(gpio_bit *g)
     gpio_out(g, !gpio_in(g));
 }
 
+/* kept for the old callers, the delay is calibrated now (see delay.h) */
 void wait_nop_approx_milliseconds(u32 ms)
 {
-	u32 i = 0;
-	u32 limit = 0;
-
-	limit = 10000 * ms;
-
-	for (i = 0; i < limit; i++) {
-		asm("nop");
-    }
+	wait_ms(ms);
 }
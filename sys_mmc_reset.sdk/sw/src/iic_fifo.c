@@ -0,0 +1,179 @@
+#include "iic_fifo.h"
+#include <string.h>
+#include "xiic_l.h"
+
+#define XFER_ERR (XIIC_INTR_TX_ERROR_MASK | XIIC_INTR_ARB_LOST_MASK) //NACK or arbitration lost
+
+static iic_fifo_stats stats;
+static u8 held = 0; //last transaction ended without STOP, the bus is still ours
+
+static u32 rd(UINTPTR base, u32 offset)
+{
+	stats.reg_rd++;
+	return XIic_ReadReg(base, offset);
+}
+
+static void wr(UINTPTR base, u32 offset, u32 value)
+{
+	stats.reg_wr++;
+	XIic_WriteReg(base, offset, value);
+}
+
+/* poll the interrupt status register until one of the MASK bits is set
+ *
+ *  returns: the interrupt status
+ */
+static u32 wait_isr(UINTPTR base, u32 mask)
+{
+	u32 isr;
+
+	do {
+		stats.polls++;
+		isr = rd(base, XIIC_IISR_OFFSET);
+	} while (!(isr & mask));
+
+	return isr;
+}
+
+/* clear the given interrupt status bits if they are set (they toggle on write) */
+static void clear_isr(UINTPTR base, u32 mask)
+{
+	u32 isr = rd(base, XIIC_IISR_OFFSET) & mask;
+
+	if (isr) wr(base, XIIC_IISR_OFFSET, isr);
+}
+
+static void abort_xfer(UINTPTR base)
+{
+	stats.errors++;
+	held = 0;
+	wr(base, XIIC_CR_REG_OFFSET, XIIC_CR_ENABLE_DEVICE_MASK | XIIC_CR_TX_FIFO_RESET_MASK);
+	wr(base, XIIC_CR_REG_OFFSET, XIIC_CR_ENABLE_DEVICE_MASK);
+	clear_isr(base, XFER_ERR);
+}
+
+/* poll the status register until (SR & MASK) == VALUE
+ *  After a NACK or a lost arbitration the core keeps the unsent TX FIFO
+ *  entries and the condition may never come: any of the ERR interrupt status
+ *  bits aborts the transfer instead
+ *
+ *  returns: 0 on success, 1 if the transfer was aborted
+ */
+static int wait_sr(UINTPTR base, u32 mask, u32 value, u32 err)
+{
+	for (;;) {
+		stats.polls++;
+		if ((rd(base, XIIC_SR_REG_OFFSET) & mask) == value) return 0;
+		if (err && (rd(base, XIIC_IISR_OFFSET) & err)) {
+			abort_xfer(base);
+			return 1;
+		}
+	}
+}
+
+/* queue the (repeated) START with the address byte */
+static void start(UINTPTR base, u8 addr7, u8 dir)
+{
+	if (!held) wait_sr(base, XIIC_SR_BUS_BUSY_MASK, 0, 0);
+	clear_isr(base, XFER_ERR);
+	wr(base, XIIC_DTR_REG_OFFSET, XIIC_TX_DYN_START_MASK | (addr7 << 1) | dir);
+}
+
+void iic_fifo_init(UINTPTR base)
+{
+	wr(base, XIIC_RESETR_OFFSET, XIIC_RESET_MASK);
+	wr(base, XIIC_RFD_REG_OFFSET, IIC_FIFO_DEPTH - 1);
+	wr(base, XIIC_CR_REG_OFFSET, XIIC_CR_ENABLE_DEVICE_MASK | XIIC_CR_TX_FIFO_RESET_MASK);
+	wr(base, XIIC_CR_REG_OFFSET, XIIC_CR_ENABLE_DEVICE_MASK);
+	held = 0;
+}
+
+unsigned iic_fifo_send(UINTPTR base, u8 addr7, u8 *buf, unsigned n, u8 option)
+{
+	unsigned i = 0, room, end;
+	u32 sr, entry;
+
+	start(base, addr7, XIIC_WRITE_OPERATION);
+	room = IIC_FIFO_DEPTH - 1; //the START entry takes one slot
+
+	while (i < n) {
+		end = (n - i < room) ? n : i + room;
+		for (; i < end; i++) {
+			entry = buf[i];
+			if (i == n - 1 && option == XIIC_STOP) entry |= XIIC_TX_DYN_STOP_MASK;
+			wr(base, XIIC_DTR_REG_OFFSET, entry);
+		}
+		if (i == n) break;
+
+		/* FIFO is full: one status poll tells how much room the bus made */
+		stats.polls++;
+		sr = rd(base, XIIC_SR_REG_OFFSET);
+		if (sr & XIIC_SR_TX_FIFO_EMPTY_MASK) {
+			room = IIC_FIFO_DEPTH;
+		} else {
+			room = IIC_FIFO_DEPTH - 1 - rd(base, XIIC_TFO_REG_OFFSET);
+		}
+		if (rd(base, XIIC_IISR_OFFSET) & XFER_ERR) {
+			abort_xfer(base);
+			return 0;
+		}
+	}
+
+	if (wait_sr(base, XIIC_SR_TX_FIFO_EMPTY_MASK, XIIC_SR_TX_FIFO_EMPTY_MASK, XFER_ERR)) return 0;
+	if (option == XIIC_STOP && wait_sr(base, XIIC_SR_BUS_BUSY_MASK, 0, XFER_ERR)) return 0;
+	if (rd(base, XIIC_IISR_OFFSET) & XFER_ERR) {
+		abort_xfer(base);
+		return 0;
+	}
+
+	held = (option != XIIC_STOP);
+	return n;
+}
+
+unsigned iic_fifo_recv(UINTPTR base, u8 addr7, u8 *buf, unsigned n, u8 option)
+{
+	unsigned i = 0, block;
+	u32 isr;
+
+	if (n == 0 || n > IIC_FIFO_MAX_READ) return 0;
+
+	block = (n < IIC_FIFO_DEPTH) ? n : IIC_FIFO_DEPTH;
+	wr(base, XIIC_RFD_REG_OFFSET, block - 1);
+	clear_isr(base, XIIC_INTR_RX_FULL_MASK);
+
+	start(base, addr7, XIIC_READ_OPERATION);
+	wr(base, XIIC_DTR_REG_OFFSET, n | ((option == XIIC_STOP) ? XIIC_TX_DYN_STOP_MASK : 0));
+
+	while (i < n) {
+		isr = wait_isr(base, XIIC_INTR_RX_FULL_MASK | XFER_ERR);
+		if (!(isr & XIIC_INTR_RX_FULL_MASK)) {
+			abort_xfer(base);
+			return 0;
+		}
+
+		/* BLOCK bytes are waiting in the RX FIFO, drain them without further checks */
+		for (; block; block--) {
+			buf[i++] = rd(base, XIIC_DRR_REG_OFFSET);
+		}
+
+		/* arm the threshold for the next block */
+		wr(base, XIIC_IISR_OFFSET, XIIC_INTR_RX_FULL_MASK);
+		block = (n - i < IIC_FIFO_DEPTH) ? n - i : IIC_FIFO_DEPTH;
+		if (block) wr(base, XIIC_RFD_REG_OFFSET, block - 1);
+	}
+
+	if (option == XIIC_STOP && wait_sr(base, XIIC_SR_BUS_BUSY_MASK, 0, XFER_ERR)) return 0;
+
+	held = (option != XIIC_STOP);
+	return n;
+}
+
+iic_fifo_stats *iic_fifo_get_stats(void)
+{
+	return &stats;
+}
+
+void iic_fifo_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,42 @@
+/*
+ * Info   : FIFO-depth-aware polled driver for the AXI IIC core in dynamic
+ *          controller mode.
+ *          The 16 entry TX FIFO is filled in bursts and the RX_FIFO_PIRQ
+ *          threshold is set so that one status check drains up to 16 received
+ *          bytes, instead of one status poll per byte as in XIic_Send/XIic_Recv.
+ */
+
+#ifndef IIC_FIFO_H
+#define IIC_FIFO_H
+
+#include <xil_types.h>
+
+#define IIC_FIFO_DEPTH    16  //depth of the axi_iic TX and RX FIFOs
+#define IIC_FIFO_MAX_READ 255 //the dynamic mode byte count is 8 bits wide
+
+typedef struct {
+	u32 reg_rd;  //register reads, status polls included
+	u32 reg_wr;  //register writes, TX FIFO writes included
+	u32 polls;   //status/interrupt register reads done while waiting
+	u32 errors;  //NACK or arbitration lost
+} iic_fifo_stats;
+
+/* Reset the core and enable it (dynamic controller mode needs no other setup) */
+void iic_fifo_init(UINTPTR base);
+
+/* Write N bytes to the slave ADDR7, OPTION is XIIC_STOP or XIIC_REPEATED_START
+ *
+ *  returns: the number of bytes sent (shall be N, 0 if the address was not acknowledged)
+ */
+unsigned iic_fifo_send(UINTPTR base, u8 addr7, u8 *buf, unsigned n, u8 option);
+
+/* Read N bytes (maximum IIC_FIFO_MAX_READ) from the slave ADDR7
+ *
+ *  returns: the number of bytes received (shall be N, 0 if the address was not acknowledged)
+ */
+unsigned iic_fifo_recv(UINTPTR base, u8 addr7, u8 *buf, unsigned n, u8 option);
+
+iic_fifo_stats *iic_fifo_get_stats(void);
+void iic_fifo_reset_stats(void);
+
+#endif // IIC_FIFO_H
@@ -0,0 +1,93 @@
+#include "lz.h"
+#include <string.h>
+
+enum { TOKEN, LIT_LEN, LITERALS, OFF_LO, OFF_HI, MATCH_LEN };
+
+void lz_init(lz_state *lz, lz_emit_fn emit)
+{
+	lz->pos    = 0;
+	lz->lit    = 0;
+	lz->match  = 0;
+	lz->offset = 0;
+	lz->state  = TOKEN;
+	lz->emit   = emit;
+}
+
+/* append one byte to the output, hand out the page when it is full */
+static int out(lz_state *lz, u8 c)
+{
+	lz->window[lz->pos % LZ_WINDOW] = c;
+	lz->pos++;
+	if (lz->pos % LZ_PAGE) return 0;
+
+	return lz->emit(lz->window + (lz->pos - LZ_PAGE) % LZ_WINDOW, LZ_PAGE);
+}
+
+static int copy_match(lz_state *lz)
+{
+	u32 len = lz->match + LZ_MIN_MATCH;
+
+	if (lz->offset == 0 || lz->offset > LZ_WINDOW || lz->offset > lz->pos) return 1;
+
+	for (; len; len--) {
+		if (out(lz, lz->window[(lz->pos - lz->offset) % LZ_WINDOW])) return 1;
+	}
+	lz->state = TOKEN;
+	return 0;
+}
+
+int lz_feed(lz_state *lz, const u8 *in, u32 n)
+{
+	u8 c;
+
+	for (; n; n--) {
+		c = *in++;
+		switch (lz->state) {
+		case TOKEN:
+			lz->lit   = c >> 4;
+			lz->match = c & 0xF;
+			lz->state = (lz->lit == 15) ? LIT_LEN : (lz->lit ? LITERALS : OFF_LO);
+			break;
+		case LIT_LEN:
+			lz->lit += c;
+			if (c != 255) lz->state = LITERALS;
+			break;
+		case LITERALS:
+			if (out(lz, c)) return 1;
+			if (--lz->lit == 0) lz->state = OFF_LO;
+			break;
+		case OFF_LO:
+			lz->offset = c;
+			lz->state  = OFF_HI;
+			break;
+		case OFF_HI:
+			lz->offset |= c << 8;
+			if (lz->match == 15) {
+				lz->state = MATCH_LEN;
+			} else if (copy_match(lz)) {
+				return 1;
+			}
+			break;
+		case MATCH_LEN:
+			lz->match += c;
+			if (c != 255 && copy_match(lz)) return 1;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int lz_finish(lz_state *lz)
+{
+	u32 len = lz->pos % LZ_PAGE;
+	u8 *page;
+
+	/* the last sequence has no match */
+	if (lz->state != OFF_LO && !(lz->state == TOKEN && lz->pos == 0)) return 1;
+	if (len == 0) return 0;
+
+	page = lz->window + (lz->pos - len) % LZ_WINDOW;
+	memset(page + len, 0xFF, LZ_PAGE - len);
+	return lz->emit(page, len);
+}
@@ -0,0 +1,55 @@
+/*
+ * Info   : Streaming decoder of LZ4-style compressed data.
+ *
+ * Stream: a list of sequences, each one is
+ *  TOKEN | [literal length bytes] | literals | OFFSET(7:0) | OFFSET(15:8) | [match length bytes]
+ *  TOKEN(7:4) is the literal length, TOKEN(3:0) the match length minus LZ_MIN_MATCH;
+ *  a nibble of 15 is followed by bytes added to it until one is not 255 (as in LZ4).
+ *  The match copies LEN bytes starting OFFSET bytes back in the output. The last
+ *  sequence ends after its literals.
+ * Unlike LZ4 the offset is limited to LZ_WINDOW, so that the history fits in a
+ * fixed buffer in BRAM: the encoder shall not look further back.
+ *
+ * The input can be fed in pieces of any size, the output is handed out in
+ * LZ_PAGE byte pages that point into the history buffer.
+ */
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <xil_types.h>
+
+#define LZ_WINDOW    4096 //history size, maximum match offset (power of 2, multiple of LZ_PAGE)
+#define LZ_PAGE      256  //output page size, one MMC flash buffer
+#define LZ_MIN_MATCH 4
+
+/* called for every output page, LEN is LZ_PAGE but for the last page
+ *  returns: 0 on success, 1 to stop the decoder
+ */
+typedef int (*lz_emit_fn)(u8 *page, u16 len);
+
+typedef struct {
+	u8  window[LZ_WINDOW] __attribute__((aligned(4)));
+	u32 pos;      //output bytes so far
+	u32 lit;      //literals left in the current sequence
+	u32 match;    //match length being decoded
+	u16 offset;
+	u8  state;
+	lz_emit_fn emit;
+} lz_state;
+
+void lz_init(lz_state *lz, lz_emit_fn emit);
+
+/* decode N more input bytes
+ *
+ *  returns: 0 on success, 1 on a corrupt stream or if EMIT failed
+ */
+int lz_feed(lz_state *lz, const u8 *in, u32 n);
+
+/* end of input: emit the last, partial, page (padded with 0xFF)
+ *
+ *  returns: 0 on success, 1 if the stream is truncated or EMIT failed
+ */
+int lz_finish(lz_state *lz);
+
+#endif // LZ_H
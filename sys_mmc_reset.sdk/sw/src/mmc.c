@@ -0,0 +1,1685 @@
+/*
+ * Info   : Access layer for the GPAC3 specific I2C commands of the MMC.
+ *          All bus traffic goes through the HAL in mmc_bus.c
+ */
+
+#include "xil_printf.h"
+#include <assert.h>
+#include <string.h>
+#include "mmc.h"
+#include "mmc_bus.h"
+#include "delay.h"
+#include "crc32.h"
+#include "sched.h"
+#include "console.h"
+
+static void mmc_send16_wait(void);
+
+/* Targets
+ *  What the driver knows of an MMC (register shadow, 16 bit transaction in
+ *  progress, last command, file metadata) is kept in its mmc_target. The
+ *  mmc_* calls work on the selected target, the MMC at MMC_I2C_ADDR7 until
+ *  another one is selected.
+ */
+static mmc_target target0 = { .addr7 = MMC_I2C_ADDR7 };
+static mmc_target *tgt = &target0;
+
+/* Send a 16 bit I2C transaction to the MMC
+ *  The MMC needs MMC_SEND16_US after it: the next transaction waits for the
+ *  rest of that time, the caller does not
+ */
+void mmc_send16(u8 c1, u8 c2)
+{
+	u32 n = 0;
+
+	u8 buf[2] = {c1, c2};
+
+	mmc_send16_wait();
+	n = mmc_bus_send(tgt->addr7, buf, 2, MMC_BUS_STOP);
+	assert(n == 2);
+	mmc_bus_flush();
+	tgt->send16_ready   = time_now_us() + MMC_SEND16_US;
+	tgt->send16_pending = 1;
+}
+
+/* wait until the MMC is ready after the last mmc_send16() */
+static void mmc_send16_wait(void)
+{
+	if (!tgt->send16_pending) return;
+	tgt->send16_pending = 0;
+	wait_until_us(tgt->send16_ready);
+}
+
+/* Repeated START chaining
+ *  Between mmc_chain_begin() and mmc_chain_end() the 32 bit writes are joined
+ *  in a single bus tenure: every write but the last one ends with a repeated
+ *  START instead of STOP + bus free time + START. The last write is held back
+ *  until it is known whether another write, a read or the end of the chain
+ *  follows it.
+ */
+static u8  chain_depth = 0;
+static u8  chain_enabled = 1;
+static u8  chain_frame[4];
+static u8  chain_pending = 0;
+static u32 chain_rstarts = 0;
+
+static void mmc_chain_flush(u8 option) {
+	if (!chain_pending) return;
+
+	chain_pending = 0;
+	mmc_bus_send(tgt->addr7, chain_frame, 4, option);
+	if (option == MMC_BUS_REPEATED_START) chain_rstarts++;
+}
+
+void mmc_chain_begin(void) {
+	chain_depth++;
+}
+
+void mmc_chain_end(void) {
+	assert(chain_depth > 0);
+	if (--chain_depth == 0) mmc_chain_flush(MMC_BUS_STOP);
+}
+
+/* enable (default) or disable chaining, when disabled every write ends with STOP */
+void mmc_chain_enable(int on) {
+	chain_enabled = on ? 1 : 0;
+}
+
+/* returns: number of writes that ended with a repeated START instead of a STOP */
+u32 mmc_chain_rstarts(void) {
+	return chain_rstarts;
+}
+
+/* Pre-encoded frames
+ *  The frames known at build time are constant tables, sent as they are:
+ *  the two halves of the secure key, the write of every command code and
+ *  the zero-data writes that set the read pointer. Only the register writes
+ *  with run time data are packed by mmc_send32().
+ */
+#define FRAME(addr, data) {(addr) >> 8, (addr) & 0xFF, (data) >> 8, (data) & 0xFF}
+#define XCMD(cmd)         FRAME(MMC_XCMD_WREG, cmd)
+
+static const u8 frame_key[2][4] = {
+	FRAME(MMC_SECURE_KEY_WREG,   MMC_SECURE_KEY >> 16),
+	FRAME(MMC_SECURE_KEY_WREG+2, MMC_SECURE_KEY & 0xFFFF),
+};
+
+static const u8 frame_xcmd[MMC_CMD_COUNT][4] = {
+	XCMD(MMC_CMD_NULL),  XCMD(MMC_CMD_FREAD), XCMD(MMC_CMD_FERASE), XCMD(MMC_CMD_FPROG),
+	XCMD(MMC_CMD_IAP0),  XCMD(MMC_CMD_IAP1),  XCMD(MMC_CMD_RESET),  XCMD(MMC_CMD_SDREAD),
+	XCMD(MMC_CMD_SDPROG), XCMD(MMC_CMD_TSD),  XCMD(MMC_CMD_WRLEN),  XCMD(MMC_CMD_CRC),
+};
+
+static const u8 frame_rd_xcmd[4] = FRAME(MMC_XCMD_RREG, 0);
+static const u8 frame_rd_res[4]  = FRAME(MMC_CMD_RESULT_RREG, 0);
+static const u8 frame_rd_addr[4] = FRAME(MMC_ADDR_RREG, 0);
+static const u8 frame_rd_data[4] = FRAME(MMC_DATA_RREG, 0);
+static const u8 frame_rd_rbuf[2][4] = { //read buffer, whole or in halves
+	FRAME(MMC_FLASH_RBUF_ADDR, 0),
+	FRAME(MMC_FLASH_RBUF_ADDR + MMC_FLASH_BUF_LEN/2, 0),
+};
+
+/* send the 4 byte FRAME, held back inside a chain (see mmc_send32)
+ *
+ *  returns: the number of bytes sent (shall be always 4)
+ */
+static unsigned send_frame(const u8 *frame) {
+
+	mmc_send16_wait();
+	if (chain_depth && chain_enabled) {
+		mmc_chain_flush(MMC_BUS_REPEATED_START);
+		memcpy(chain_frame, frame, 4);
+		chain_pending = 1;
+		return 4;
+	}
+
+	return( mmc_bus_send(tgt->addr7, (u8 *)frame, 4, MMC_BUS_STOP) ); //only read by the backends
+}
+
+/* set up T for the MMC at ADDR7, nothing is known of its state yet */
+void mmc_target_init(mmc_target *t, u8 addr7) {
+	memset(t, 0, sizeof(*t));
+	t->addr7 = addr7;
+}
+
+/* make T the target of the following mmc_* calls, NULL for the MMC at MMC_I2C_ADDR7
+ *  A chained write held back for the previous target is sent first
+ *
+ *  returns: the previously selected target
+ */
+mmc_target *mmc_target_select(mmc_target *t) {
+	mmc_target *prev = tgt;
+
+	if (!t) t = &target0;
+	if (t != tgt) mmc_chain_flush(MMC_BUS_STOP);
+	tgt = t;
+
+	return prev;
+}
+
+/* returns: the selected target */
+mmc_target *mmc_target_get(void) {
+	return tgt;
+}
+
+static void meta_touch(u16 cmd);
+
+/* Register shadow
+ *  Copy of what the MMC currently holds in its ADDR, DATA and SECURE_KEY
+ *  registers, so that only the 16 bit halves that change are written and
+ *  the key is not sent again while it is still loaded. The shadow is dropped
+ *  by the commands that reboot the MMC and when a command fails or times out.
+ *  SHADOW_WBUF tells what the write buffer holds for the checkpoint records
+ *  (see ckpt_program), any other use of the buffer and FERASE drop it.
+ */
+#define SHADOW_ADDR 0x1
+#define SHADOW_DATA 0x2
+#define SHADOW_KEY  0x4
+#define SHADOW_WBUF 0x8 //the write buffer is 0xFF but for bytes already programmed in the checkpoint page
+
+static u32 shadow_skipped = 0;
+
+/* write the 32 bit register at WADDR, only the halves that differ from the shadow
+ *
+ *  returns: number of bytes sent
+ */
+static unsigned shadow_write32(u16 waddr, u32 *shadow, u8 flag, u32 value) {
+	unsigned ret = 0;
+
+	mmc_chain_begin();
+	if (!(tgt->shadow_valid & flag) || (*shadow>>16) != (value>>16)) {
+		ret += mmc_send32(waddr, value>>16);
+	} else {
+		shadow_skipped++;
+	}
+	if (!(tgt->shadow_valid & flag) || (*shadow&0xFFFF) != (value&0xFFFF)) {
+		ret += mmc_send32(waddr+2, value&0xFFFF);
+	} else {
+		shadow_skipped++;
+	}
+	mmc_chain_end();
+
+	*shadow = value;
+	tgt->shadow_valid |= flag;
+
+	return ret;
+}
+
+/* forget the register shadow, the next writes go to the MMC unconditionally */
+void mmc_shadow_invalidate(void) {
+	tgt->shadow_valid = 0;
+}
+
+/* returns: number of 32 bit register writes saved by the shadow */
+u32 mmc_shadow_skipped(void) {
+	return shadow_skipped;
+}
+
+/* Send a 32 bit I2C transaction to the MMC
+ *  ADDR: 1st and 2nd byte in payload (MSB first)
+ *  DATA: 3rd and 4th byte in payload (MSB first)
+ *
+ *  I2C transaction: START | 0x7C | ADDR(15:8) | ADDR(7:0) | DATA(15:8) | DATA(7:0) | (ACK) | STOP
+ *
+ *  returns: the number of bytes sent (shall be always 4)
+ */
+unsigned mmc_send32(u16 addr, u16 data) {
+
+	u8 txbuf[4];
+
+	txbuf[0] = addr >> 8;
+	txbuf[1] = addr & 0xFF;
+	txbuf[2] = data >> 8;
+	txbuf[3] = data & 0xFF;
+
+	return( send_frame(txbuf) );
+}
+
+/* Read N bytes of data via I2C from MMC
+ *  RXBUF: buffer used to store the received data
+ *  N    : number of bytes requested
+ *
+ *  The read address shall be set previously with a write transaction (either 32 or 16 bit)
+ *  Inside a chain the address write is joined to the read with a repeated START
+ *
+ *  returns: the number of bytes received (shall be N)
+ */
+unsigned mmc_read(u8 *rxbuf, u16 n) {
+
+	mmc_send16_wait();
+	mmc_chain_flush(MMC_BUS_REPEATED_START);
+
+	return( mmc_bus_recv(tgt->addr7, rxbuf, n, MMC_BUS_STOP) );
+
+}
+
+/* Execute GPAC3 command
+ *  Writes the CMD argument to address MMC_XCMD_REG (0x800)
+ *  The command outcome shall be always checked by reading the RESULT register with mmc_get_cmd_res()
+ *
+ *  returns: the number of bytes sent (shall be 4)
+ */
+unsigned mmc_execute_cmd(u16 cmd) {
+
+	tgt->last_cmd  = cmd;
+	tgt->last_read = 0;
+	switch (cmd) {
+	case MMC_CMD_IAP0:
+	case MMC_CMD_IAP1:
+	case MMC_CMD_RESET:
+	case MMC_CMD_TSD:
+		mmc_shadow_invalidate(); //the MMC reboots, its registers are cleared
+		break;
+	case MMC_CMD_FERASE:
+		tgt->shadow_valid &= ~SHADOW_WBUF; //the checkpoint page may be blank again
+		meta_touch(cmd);
+		break;
+	case MMC_CMD_FPROG:
+	case MMC_CMD_WRLEN:
+	case MMC_CMD_CRC:
+		meta_touch(cmd); //may change a file's size or CRC
+		break;
+	}
+	if (cmd < MMC_CMD_COUNT) return( send_frame(frame_xcmd[cmd]) );
+	return( mmc_send32(MMC_XCMD_WREG, cmd) );
+
+}
+
+/* write MMC address register
+ *  ADDR: 32-bit address
+ *  Only the 16 bit halves that differ from the shadowed value are sent
+ *
+ *  returns: number of bytes sent (0, 4 or 8)
+ */
+unsigned mmc_set_addr(u32 addr) {
+	return shadow_write32(MMC_ADDR_WREG, &tgt->shadow_addr, SHADOW_ADDR, addr);
+}
+
+/* get current address register stored in MMC
+ *  The shadowed value is returned without bus traffic when it is valid
+ *
+ *  returns: 32-bit address read from MMC's command address register
+ */
+u32 mmc_get_addr(void) {
+	u8 rxbuf[4];
+
+	if (tgt->shadow_valid & SHADOW_ADDR) return tgt->shadow_addr;
+
+	mmc_chain_begin();
+	send_frame(frame_rd_addr);
+	mmc_read(rxbuf, 4);
+	mmc_chain_end();
+
+	tgt->shadow_addr = buf8_to_32(rxbuf);
+	tgt->shadow_valid |= SHADOW_ADDR;
+
+	return (tgt->shadow_addr);
+}
+
+/* write MMC data register
+ *  DATA: 32-bit value to be written
+ *  Only the 16 bit halves that differ from the shadowed value are sent
+ *
+ *  returns: nothing
+ */
+void mmc_set_data(u32 data) {
+	shadow_write32(MMC_DATA_WREG, &tgt->shadow_data, SHADOW_DATA, data);
+}
+
+/* get current data register stored in MMC
+ *  The shadowed value is returned without bus traffic when it is valid
+ *
+ *  returns: 32-bit value read from MMC's command data register
+ */
+u32 mmc_get_data(void) {
+	u8 rxbuf[4];
+
+	if (tgt->shadow_valid & SHADOW_DATA) return tgt->shadow_data;
+
+	mmc_chain_begin();
+	send_frame(frame_rd_data);
+	mmc_read(rxbuf, 4);
+	mmc_chain_end();
+
+	tgt->shadow_data = buf8_to_32(rxbuf);
+	tgt->shadow_valid |= SHADOW_DATA;
+
+	return (tgt->shadow_data);
+}
+
+/* get command result register stored in MMC
+ *  The register's 2 MSB contain the code of the last executed command,
+ *  the 2 LSB contain the command's result code
+ *
+ *  returns: 32-bit value read from MMC's command result register
+ */
+u32 mmc_get_cmd_res(void) {
+	u8 rxbuf[4];
+
+	mmc_chain_begin();
+	send_frame(frame_rd_res);
+	mmc_read(rxbuf, 4);
+	mmc_chain_end();
+
+	return (buf8_to_32(rxbuf));
+}
+
+
+/* Completion polling
+ *  Each command has its own pacing: the first poll is placed after a learned
+ *  delay (FIRST_US until there is one), then the interval doubles up to MAX_US
+ *  until TIMEOUT_MS is reached. When the first poll already finds the command
+ *  done the learned delay shrinks by 1/8, otherwise it moves half way between
+ *  the last poll that found the MMC busy and the one that found it done.
+ *  The polls are placed at deadlines counted from the end of the command
+ *  write, so the bus time of a poll is part of the interval and not added to
+ *  it. Latencies are measured on the timebase (delay.h).
+ */
+typedef struct {
+	u32 first_us;
+	u32 max_us;
+	u32 timeout_ms;
+} mmc_cmd_policy;
+
+static const mmc_cmd_policy cmd_policy[MMC_CMD_COUNT] = {
+	{    0,   100,   100}, //NULL
+	{   50,   200,   100}, //FREAD
+	{20000, 50000,  5000}, //FERASE: 64KiB sector
+	{  200,  1000,   100}, //FPROG: 256B page
+	{    0,  1000,  1000}, //IAP0
+	{    0,  1000,  1000}, //IAP1
+	{    0,  1000,  1000}, //RESET
+	{  200,  2000,  1000}, //SDREAD
+	{  500,  5000,  1000}, //SDPROG
+	{    0,  1000,  1000}, //TSD
+	{ 5000, 20000,  2000}, //WRLEN
+	{ 5000, 50000, 10000}, //CRC: whole file
+};
+
+static mmc_cmd_stats cmd_stats[MMC_CMD_COUNT];
+static mmc_io_stats  io_stats;
+
+/* returns: the time command CMD is expected to take, the learned delay before its first poll */
+static u32 cmd_expect_us(u16 cmd) {
+	return cmd_stats[cmd].next_us ? cmd_stats[cmd].next_us : cmd_policy[cmd].first_us;
+}
+
+/* wait for the completion of command CMD, that was on the wire at time T0 (see mmc_wait_cmd_res)
+ *
+ *  returns: the command result register, or CMD<<16 | MMC_RES_TIMEOUT on timeout
+ */
+static u32 wait_cmd_res(u16 cmd, u32 t0) {
+	const mmc_cmd_policy *p;
+	mmc_cmd_stats *st;
+	u32 res, delay, due = 0, at, busy_at = 0, elapsed, polls = 0, t;
+	u16 bin;
+
+	if (cmd >= MMC_CMD_COUNT) return ((u32)cmd<<16) | MMC_RES_TIMEOUT;
+	p  = &cmd_policy[cmd];
+	st = &cmd_stats[cmd];
+
+	delay = st->next_us ? st->next_us : p->first_us;
+	for (;;) {
+		if (delay) {
+			due += delay;
+			t = time_now_us();
+			sched_yield(); //the other tasks run while the MMC works
+			wait_until_us(t0 + due);
+			io_stats.wait_us += time_now_us() - t;
+		}
+		at  = time_now_us() - t0;
+		res = mmc_get_cmd_res();
+		st->polls++;
+		polls++;
+
+		if ((res>>16) == cmd) {
+			if (cmd == tgt->last_cmd) tgt->last_read = 1;
+			if (res & 0xFFFF) mmc_shadow_invalidate(); //e.g. the MMC was reset and lost the key
+			break;
+		}
+		busy_at = at;
+		if (time_now_us() - t0 >= 1000*p->timeout_ms) {
+			st->timeouts++;
+			mmc_shadow_invalidate(); //the MMC state is unknown now
+			return ((u32)cmd<<16) | MMC_RES_TIMEOUT;
+		}
+
+		delay = delay ? 2*delay : p->first_us;
+		if (delay > p->max_us) delay = p->max_us;
+		if (delay == 0) delay = MMC_POLL_US;
+	}
+
+	/* hit: try a little earlier next time, miss: half way between busy and done */
+	st->next_us = (polls == 1) ? delay - delay/8 : busy_at + (at - busy_at)/2;
+
+	elapsed = time_now_us() - t0;
+	st->count++;
+	st->total_us += elapsed;
+	for (t = elapsed>>6, bin = 0; t && bin < MMC_HIST_BINS-1; t >>= 1) bin++;
+	st->hist[bin]++;
+	if (st->count == 1 || elapsed < st->min_us) st->min_us = elapsed;
+	if (elapsed > st->max_us) st->max_us = elapsed;
+
+	return res;
+}
+
+/* Wait for the completion of command CMD
+ *  Polls MMC_CMD_RESULT_RREG until its upper 16 bits match CMD
+ *
+ *  returns: the command result register, or CMD<<16 | MMC_RES_TIMEOUT on timeout
+ */
+u32 mmc_wait_cmd_res(u16 cmd) {
+	/* the command shall be on the wire before the time starts */
+	mmc_chain_flush(MMC_BUS_STOP);
+	mmc_bus_flush();
+
+	return wait_cmd_res(cmd, time_now_us());
+}
+
+static u8 stretch = 1; //the MMC stretches SCL while a command runs
+
+/* tell whether the MMC stretches SCL while a command runs (default) or not
+ *  Without it the result register keeps the previous result until the new
+ *  command is done and writes are dropped while a command runs
+ */
+void mmc_set_stretch(int on) {
+	stretch = on ? 1 : 0;
+}
+
+/* Execute GPAC3 command without waiting for its completion (see mmc_wait_cmd_res)
+ *  If CMD is the same as the previous command and that one's result was not
+ *  read back, a NULL command is written first so that the previous result
+ *  cannot be taken for the new one. It is not waited for: the MMC holds the
+ *  next write until it is done. An MMC that does not stretch SCL needs the
+ *  NULL after every command of the same code, and its completion
+ *
+ *  returns: the number of bytes sent (shall be 4)
+ */
+unsigned mmc_start_cmd(u16 cmd) {
+
+	if (cmd == tgt->last_cmd && cmd != MMC_CMD_NULL && (!stretch || !tgt->last_read)) {
+		mmc_execute_cmd(MMC_CMD_NULL);
+		if (!stretch) mmc_wait_cmd_res(MMC_CMD_NULL);
+	}
+
+	return( mmc_execute_cmd(cmd) );
+}
+
+/* Execute GPAC3 command and wait for its completion
+ *
+ *  returns: the command result register (lower 16 bits are 0 on success)
+ */
+u32 mmc_run_cmd(u16 cmd) {
+
+	mmc_start_cmd(cmd);
+
+	return mmc_wait_cmd_res(cmd);
+}
+
+/* Start the command sequence S without waiting for its completion (see mmc_wait_cmd_res)
+ *  The secure key, if S asks for it and it is not loaded yet, and the command
+ *  are sent from their pre-encoded frames in one bus tenure, joined to the
+ *  writes of an enclosing chain (e.g. the address of the command)
+ *
+ *  returns: the number of bytes of the command write (shall be 4)
+ */
+unsigned mmc_start_seq(const mmc_seq *s) {
+
+	unsigned ret;
+
+	assert(s->cmd < MMC_CMD_COUNT);
+	mmc_chain_begin();
+	if (s->unlock) mmc_unlock();
+	ret = mmc_start_cmd(s->cmd);
+	mmc_chain_end();
+
+	return (ret);
+}
+
+/* Run the command sequence S: unlock, execute, then poll its result
+ *
+ *  returns: the command result register (lower 16 bits are 0 on success)
+ */
+u32 mmc_run_seq(const mmc_seq *s) {
+
+	mmc_start_seq(s);
+
+	return mmc_wait_cmd_res(s->cmd);
+}
+
+/* returns: completion statistics of command CMD */
+mmc_cmd_stats *mmc_get_cmd_stats(u16 cmd) {
+	return (cmd < MMC_CMD_COUNT) ? &cmd_stats[cmd] : NULL;
+}
+
+void mmc_reset_cmd_stats(void) {
+	memset(cmd_stats, 0, sizeof(cmd_stats));
+}
+
+/* print the completion latency of every command used so far, then its histogram */
+void mmc_print_cmd_stats(void) {
+	static const char *name[MMC_CMD_COUNT] = {
+		"NULL", "FREAD", "FERASE", "FPROG", "IAP0", "IAP1",
+		"RESET", "SDREAD", "SDPROG", "TSD", "WRLEN", "CRC"
+	};
+	u16 i, b;
+
+	xil_printf("\n\rcommand  count   min[us]   avg[us]   max[us]  polls timeouts\n\r");
+	for (i=0; i<MMC_CMD_COUNT; i++) {
+		if (cmd_stats[i].count == 0 && cmd_stats[i].timeouts == 0) continue;
+		xil_printf("%-7s %6d %9d %9d %9d %6d %8d\n\r", name[i], cmd_stats[i].count, cmd_stats[i].min_us,
+			cmd_stats[i].count ? cmd_stats[i].total_us/cmd_stats[i].count : 0,
+			cmd_stats[i].max_us, cmd_stats[i].polls, cmd_stats[i].timeouts);
+	}
+
+	xil_printf("\n\rcompletion time [us] <");
+	for (b=0; b<MMC_HIST_BINS-1; b++) xil_printf("%6d", 64<<b);
+	xil_printf("  more\n\r");
+	for (i=0; i<MMC_CMD_COUNT; i++) {
+		if (cmd_stats[i].count == 0) continue;
+		xil_printf("%-21s ", name[i]);
+		for (b=0; b<MMC_HIST_BINS; b++) xil_printf("%6d", cmd_stats[i].hist[b]);
+		xil_printf("\n\r");
+	}
+}
+
+/* returns: page and wait counters */
+mmc_io_stats *mmc_get_io_stats(void) {
+	return &io_stats;
+}
+
+/* estimate of the time spent in the mmc_* layer: wire time of the transactions plus waits
+ *
+ *  returns: microseconds since the last mmc_reset_stats()
+ */
+u32 mmc_stats_time_us(void) {
+	return (u32)(((u64)mmc_bus_get_stats()->scl_cycles * 1000000) / mmc_bus_get_scl_hz()) + io_stats.wait_us;
+}
+
+/* reset all the counters: bus transactions, commands, pages, shadow and chains */
+void mmc_reset_stats(void) {
+	mmc_bus_reset_stats();
+	mmc_reset_cmd_stats();
+	memset(&io_stats, 0, sizeof(io_stats));
+	shadow_skipped = 0;
+	chain_rstarts  = 0;
+}
+
+/* print the bus counters, the command latencies and the page throughput */
+void mmc_print_stats(void) {
+	mmc_bus_stats *bs = mmc_bus_get_stats();
+	u32 us = mmc_stats_time_us(), pages = io_stats.pages_rx + io_stats.pages_tx;
+
+	xil_printf("\n\rbus: %d writes (%d bytes, %d short), %d reads (%d bytes, %d short), %d failed, %d repeated STARTs\n\r",
+		bs->sends, bs->bytes_tx, bs->short_tx, bs->recvs, bs->bytes_rx, bs->short_rx, bs->errors, bs->rstarts);
+	xil_printf("speed: %d kHz now, %d fallbacks to a slower profile\n\r", mmc_bus_get_scl_hz()/1000, bs->fallbacks);
+	xil_printf("time: %d ms on the wire at %d kHz + %d ms waiting for results = %d ms\n\r",
+		(us - io_stats.wait_us)/1000, mmc_bus_get_scl_hz()/1000, io_stats.wait_us/1000, us/1000);
+	xil_printf("pages: %d read, %d written, %d pages/s\n\r", io_stats.pages_rx, io_stats.pages_tx,
+		us ? (u32)(((u64)pages * 1000000) / us) : 0);
+	xil_printf("register writes skipped by the shadow %d, repeated STARTs in chains %d\n\r",
+		mmc_shadow_skipped(), mmc_chain_rstarts());
+	mmc_print_cmd_stats();
+}
+
+/* Get data buffer from MMC
+ *  BUF: local buffer where read data will be stored. Shall be able to contain at least N bytes
+ *  N  : number of bytes to read (maximum 256)
+ *
+ *  returns: number of bytes read (shall be N)
+ */
+unsigned mmc_get_buffer(u8 *buf, u16 n) {
+	unsigned ret = 0, i, len;
+
+	n = (n>MMC_FLASH_BUF_LEN)?MMC_FLASH_BUF_LEN:n;
+	if (n == MMC_FLASH_BUF_LEN) io_stats.pages_rx++;
+
+	/* the backend may not read the whole buffer in one go: read it in halves then */
+	mmc_chain_begin();
+	for (i=0; i<n; i+=len) {
+		len = (n-i > MMC_BUS_MAX_READ) ? MMC_FLASH_BUF_LEN/2 : n-i;
+		send_frame(frame_rd_rbuf[i / (MMC_FLASH_BUF_LEN/2)]); //I is 0 or half the buffer
+		ret += mmc_read(buf+i, len);
+	}
+	mmc_chain_end();
+
+	return (ret);
+}
+
+/* Write contant of data buffer in MMC
+ *  BUF: local buffer containing data to be written. Shall contain at least N bytes
+ *  N  : number of bytes to write (maximum 256)
+ *
+ *  returns: number of bytes written (shall be N)
+ */
+unsigned mmc_set_buffer(u8 *buf, u16 n) {
+
+	unsigned ret = 0, i;
+
+	n = (n>MMC_FLASH_BUF_LEN)?MMC_FLASH_BUF_LEN:n;
+	if (n == MMC_FLASH_BUF_LEN) io_stats.pages_tx++;
+	tgt->shadow_valid &= ~SHADOW_WBUF;
+
+	mmc_chain_begin();
+	for (i=0; i<n; i+=2) {
+		ret += mmc_send32(i+MMC_FLASH_WBUF_ADDR, buf8_to_16((buf+i)) );
+	}
+	mmc_chain_end();
+
+	return (ret);
+}
+
+/* get all command registers from MMC
+ *  BUF: buffer where the read data is stored (shall be able to contain at least 20B
+ *
+ *  returns: number of bytes read (shall be 20)
+ */
+unsigned mmc_get_cmd_regs(u8 *buf) {
+
+	unsigned n;
+
+	mmc_chain_begin();
+	send_frame(frame_rd_xcmd);
+	n = mmc_read(buf, 20);
+	mmc_chain_end();
+
+	return (n);
+}
+
+/* Bus speed negotiation
+ *  The command registers are read at standard mode as the reference. From
+ *  MAX_SPEED down, a profile is kept if MMC_SPEED_PROBES reads of the same
+ *  registers come back whole and equal to the reference. A short or a wrong
+ *  read makes the next profile be tried.
+ *
+ *  returns: the speed profile in use, MMC_BUS_SPEED_SM also if the MMC does not answer
+ */
+u8 mmc_speed_negotiate(u8 max_speed) {
+	u8  ref[20], buf[20], sp, i;
+
+	if (max_speed >= MMC_BUS_SPEED_COUNT) max_speed = MMC_BUS_SPEED_COUNT - 1;
+	mmc_bus_set_speed(MMC_BUS_SPEED_SM);
+	if (mmc_get_cmd_regs(ref) != sizeof(ref)) {
+		xil_printf("mmc_speed_negotiate()::ERROR::The MMC does not answer at %d kHz\n\r", mmc_bus_get_scl_hz()/1000);
+		return MMC_BUS_SPEED_SM;
+	}
+
+	for (sp = max_speed; sp > MMC_BUS_SPEED_SM; sp--) {
+		mmc_bus_set_speed(sp);
+		for (i = 0; i < MMC_SPEED_PROBES; i++) {
+			if (mmc_get_cmd_regs(buf) != sizeof(buf) || memcmp(buf, ref, sizeof(ref))) break;
+		}
+		if (i == MMC_SPEED_PROBES) break;
+	}
+	if (sp == MMC_BUS_SPEED_SM) mmc_bus_set_speed(MMC_BUS_SPEED_SM);
+
+	return sp;
+}
+
+/* Negotiate the bus speed again, up to MAX_SPEED, if transactions failed since the last call
+ *  An MMC back from a reboot and a bus that became too fast for it both
+ *  show up as short or failed transactions. To be called while no job uses
+ *  the bus, e.g. from a periodic check of the MMC
+ *
+ *  returns: the speed profile in use
+ */
+u8 mmc_speed_recover(u8 max_speed) {
+	static u32 failed = 0; //failed transactions seen by the last call
+	mmc_bus_stats *bs = mmc_bus_get_stats();
+	u8  sp = mmc_bus_get_speed();
+	u32 n  = bs->short_tx + bs->short_rx + bs->errors;
+
+	if (n == failed) return sp;
+	if (n < failed) { //the statistics were reset
+		failed = n;
+		return sp;
+	}
+
+	if (mmc_speed_negotiate(max_speed) < sp) bs->fallbacks++;
+	bs = mmc_bus_get_stats();
+	failed = bs->short_tx + bs->short_rx + bs->errors; //the probes of the negotiation included
+
+	return mmc_bus_get_speed();
+}
+
+/* display any local buffer on UART console
+ *  BUF: pointer to local buffer
+ *  N:   number of bytes to display
+ *  Every line is formatted first, then queued on the console as a whole
+ */
+void mmc_display_buffer(u8 *buf, u16 n) {
+	static const char hex[] = "0123456789abcdef";
+	char line[5 + 16*2 + 4], *p = line; //one line of 16 bytes, queued at once
+	u16 i;
+
+	n = (n>MMC_FLASH_BUF_LEN)?MMC_FLASH_BUF_LEN:n;
+
+	for(i=0; i<n; i++) {
+		if (i%16 == 0) {
+			p = line;
+			*p++ = '\n';
+			*p++ = '\r';
+			*p++ = hex[(i >> 4) & 0xF];
+			*p++ = hex[i & 0xF];
+			*p++ = ':';
+		}
+		if (i%4  == 0) *p++ = ' ';
+		*p++ = hex[buf[i] >> 4];
+		*p++ = hex[buf[i] & 0xF];
+		if (i%16 == 15 || i == n-1) console_write(line, p - line);
+	}
+}
+
+/* Send unlock code to enable secured commands
+ *  this function shall be executed before sending any of the protected commands
+ *  Nothing is sent while the key is still loaded in the MMC (see the register shadow)
+ *
+ *  returns: nothing
+ */
+void mmc_unlock() {
+	if ((tgt->shadow_valid & SHADOW_KEY) && tgt->shadow_key == MMC_SECURE_KEY) {
+		shadow_skipped += 2;
+		return;
+	}
+
+	mmc_chain_begin();
+	send_frame(frame_key[0]);
+	send_frame(frame_key[1]);
+	mmc_chain_end();
+
+	tgt->shadow_key = MMC_SECURE_KEY;
+	tgt->shadow_valid |= SHADOW_KEY;
+}
+
+/* sequences of the file copies */
+static const mmc_seq seq_fread  = {MMC_CMD_FREAD,  0};
+static const mmc_seq seq_ferase = {MMC_CMD_FERASE, 1};
+static const mmc_seq seq_fprog  = {MMC_CMD_FPROG,  1};
+static const mmc_seq seq_wrlen  = {MMC_CMD_WRLEN,  1};
+static const mmc_seq seq_crc    = {MMC_CMD_CRC,    1};
+
+static mmc_copy_stats copy_stats;
+static u8  page_buf[MMC_FLASH_BUF_LEN] __attribute__((aligned(4))); //second page buffer of the file copy
+static u32 crc_adr; //source address of the next page to be added to copy_stats.crc
+static u32 crc_end; //source address of the end of file
+
+/* add the source page at ADR to the CRC of the copied data if it is the next one in the file */
+static void crc_page(u32 adr, const u8 *buf) {
+	u32 n;
+
+	if (adr != crc_adr || adr >= crc_end) return;
+
+	n = crc_end - adr;
+	if (n > MMC_FLASH_BUF_LEN) n = MMC_FLASH_BUF_LEN;
+	copy_stats.crc = crc32_update(copy_stats.crc, buf, n);
+	crc_adr += MMC_FLASH_BUF_LEN;
+}
+
+/* read one flash page into BUF
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int read_page(u32 adr, u8 *buf) {
+	u32 res;
+
+	mmc_set_addr(adr);
+	res = mmc_run_cmd(MMC_CMD_FREAD); //read from FLASH into MMC's buffer
+	if ( res & 0xFFFF) {
+		xil_printf("\n\rcopy_flash_file()::ERROR::Could not read FLASH address 0x%08X\n\r", adr);
+		return 1;
+	}
+	copy_stats.pages_read++;
+
+	/* load MMC's read buffer into local buffer */
+	mmc_get_buffer(buf, MMC_FLASH_BUF_LEN);
+	return 0;
+}
+
+/* start the erase of the 64KiB sector at ADR, mmc_wait_cmd_res(MMC_CMD_FERASE) shall follow */
+static void erase_start(u32 adr) {
+	mmc_chain_begin();
+	mmc_set_addr(adr);
+	mmc_start_seq(&seq_ferase);
+	mmc_chain_end();
+}
+
+/* wait for the erase of the sector at ADR started with erase_start()
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int erase_wait(u32 adr) {
+	u32 res;
+
+	res = mmc_wait_cmd_res(MMC_CMD_FERASE);
+	if ( res & 0xFFFF) {
+		xil_printf("\n\rcopy_flash_file()::ERROR::Could not erase FLASH sector 0x%08X\n\r", adr);
+		return 1;
+	}
+	return 0;
+}
+
+/* erase the 64KiB sector starting at ADR
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int erase_sector(u32 adr) {
+	erase_start(adr);
+	return erase_wait(adr);
+}
+
+/* check if a page is blank (all 0xFF), one 32 bit word at a time
+ *  BUF: local page buffer, shall be 4 bytes aligned
+ *
+ * returns: 1 if all bytes are 0xFF, 0 otherwise
+ */
+int mmc_page_blank(const u8 *buf) {
+	const u32 *w = (const u32 *)buf;
+	u16 i;
+
+	for (i=0; i<MMC_FLASH_BUF_LEN/4; i++) {
+		if (w[i] != 0xFFFFFFFF) return 0;
+	}
+
+	return 1;
+}
+
+/* program the MMC's write buffer into the flash page at ADR
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int prog_buffer(u32 adr) {
+	u32 res;
+
+	mmc_chain_begin();
+	mmc_set_addr(adr);
+	mmc_start_seq(&seq_fprog);
+	mmc_chain_end();
+	res = mmc_wait_cmd_res(MMC_CMD_FPROG);
+	if ( res & 0xFFFF) {
+		xil_printf("\n\rcopy_flash_file()::ERROR::Could not write FLASH address 0x%08X\n\r", adr);
+		return 1;
+	}
+	return 0;
+}
+
+/* program BUF into the flash page at ADR
+ *  Blank pages are not sent: programming 0xFF leaves the flash as it is
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int prog_page(u32 adr, u8 *buf) {
+	if (mmc_page_blank(buf)) {
+		copy_stats.pages_blank++;
+		return 0;
+	}
+
+	/* write read buffer to MMC's write buffer */
+	mmc_set_buffer(buf, MMC_FLASH_BUF_LEN);
+	if (prog_buffer(adr)) return 1;
+
+	copy_stats.pages_programmed++;
+	return 0;
+}
+
+/* compare the source page SRC with the destination page DST
+ *
+ * returns: 0 if they are equal, 1 if DST can be turned into SRC by programming (only 1->0 bits),
+ *          2 if the destination sector has to be erased first
+ */
+static int page_cmp(const u8 *src, const u8 *dst) {
+	int ret = 0;
+	u16 i;
+
+	for (i=0; i<MMC_FLASH_BUF_LEN; i++) {
+		if (src[i] == dst[i]) continue;
+		if ((src[i] & dst[i]) != src[i]) return 2;
+		ret = 1;
+	}
+
+	return ret;
+}
+
+/* update NPAGES pages of the destination sector at DST_ADR from SRC_ADR
+ *  First pass: every source page is compared with the destination page, a page
+ *  that needs a 0->1 transition stops the pass since the whole sector will be
+ *  erased and programmed anyway. Second pass: the differing pages are read
+ *  again from the source and programmed.
+ *  BUF: local page buffer, 4 bytes aligned
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int update_sector(u32 src_adr, u32 dst_adr, u16 npages, u8 *buf) {
+	u8 *dst_buf = page_buf;
+	u8  todo[FLASH_SECTOR_SIZE/MMC_FLASH_BUF_LEN/8]; //one bit per page to be programmed
+	u16 i, erase = 0;
+
+	memset(todo, 0, sizeof(todo));
+	for (i=0; i<npages && !erase; i++) {
+		if (read_page(dst_adr + i*MMC_FLASH_BUF_LEN, dst_buf)) return 1;
+		if (read_page(src_adr + i*MMC_FLASH_BUF_LEN, buf)) return 1;
+		crc_page(src_adr + i*MMC_FLASH_BUF_LEN, buf);
+		switch (page_cmp(buf, dst_buf)) {
+		case 0:
+			break;
+		case 1:
+			todo[i/8] |= 1<<(i%8);
+			break;
+		default:
+			erase = 1;
+		}
+	}
+
+	if (erase) {
+		if (erase_sector(dst_adr)) return 1;
+		copy_stats.sectors_erased++;
+		memset(todo, 0xFF, sizeof(todo));
+	}
+
+	for (i=0; i<npages; i++) {
+		if (!(todo[i/8] & (1<<(i%8)))) {
+			copy_stats.pages_skipped++;
+			continue;
+		}
+		if (read_page(src_adr + i*MMC_FLASH_BUF_LEN, buf)) return 1;
+		crc_page(src_adr + i*MMC_FLASH_BUF_LEN, buf);
+		if (prog_page(dst_adr + i*MMC_FLASH_BUF_LEN, buf)) return 1;
+	}
+
+	return 0;
+}
+
+/* Copy checkpoint
+ *  The full copy logs its progress in the first page of MMC_CKPT_ADDR, one
+ *  flash program per record since programming only clears bits:
+ *   0x00: 'CKPT' | SRC_ID | DST_ID | 0xFFFF | file size | source CRC
+ *   0x10: one 8 byte record per programmed sector K:
+ *         'S' | K | 0xFFFF | CRC of the file up to the end of sector K
+ *  A copy with the same arguments resumes after the last recorded sector, once
+ *  the last page of every recorded sector is found equal to the source. The
+ *  magic is cleared when the copy is over.
+ */
+#define PAGES_PER_SECTOR (FLASH_SECTOR_SIZE/MMC_FLASH_BUF_LEN)
+#define CKPT_REC_OFFSET  16
+#define CKPT_REC_LEN     8
+
+/* program the N bytes of REC at offset OFF of the checkpoint page
+ *  The whole write buffer is programmed, so it is sent as a 0xFF page with
+ *  the record, unless it still holds the previous checkpoint write: then only
+ *  the record is sent, the other bytes are already programmed in the page
+ *  BUF: local page buffer
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int ckpt_program(u16 off, const u8 *rec, u16 n, u8 *buf) {
+	u16 i;
+
+	if (tgt->shadow_valid & SHADOW_WBUF) {
+		mmc_chain_begin();
+		for (i=0; i<n; i+=2) mmc_send32(MMC_FLASH_WBUF_ADDR+off+i, buf8_to_16((rec+i)));
+		mmc_chain_end();
+	} else {
+		memset(buf, 0xFF, MMC_FLASH_BUF_LEN);
+		memcpy(buf+off, rec, n);
+		mmc_set_buffer(buf, MMC_FLASH_BUF_LEN);
+	}
+	if (prog_buffer(MMC_CKPT_ADDR)) return 1;
+	tgt->shadow_valid |= SHADOW_WBUF;
+
+	copy_stats.checkpoints++;
+	return 0;
+}
+
+/* record that sector K is programmed, the file CRC so far is in copy_stats.crc */
+static int ckpt_sector(u16 k, u8 *buf) {
+	u8 rec[CKPT_REC_LEN] = {'S', k, 0xFF, 0xFF, copy_stats.crc>>24, copy_stats.crc>>16, copy_stats.crc>>8, copy_stats.crc};
+
+	return ckpt_program(CKPT_REC_OFFSET + k*CKPT_REC_LEN, rec, CKPT_REC_LEN, buf);
+}
+
+/* invalidate the checkpoint */
+static int ckpt_close(u8 *buf) {
+	u8 rec[4] = {0, 0, 0, 0};
+
+	return ckpt_program(0, rec, 4, buf);
+}
+
+/* look for a checkpoint of the same copy and check the sectors it reports as done
+ *  Without one, a new checkpoint is started. On return *FIRST is the first
+ *  sector to be copied and copy_stats.crc the CRC of the file before it.
+ *  BUF: local page buffer
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int ckpt_open(u8 src_id, u8 dst_id, u32 file_size, u32 file_crc, u16 npages, u16 *first, u8 *buf) {
+	u32 src_adr = src_id * FLASH_FILE_SIZE, dst_adr = dst_id * FLASH_FILE_SIZE, res, crc = 0;
+	u16 k, n = 0, last, blank;
+	u8  hdr[16] = {'C', 'K', 'P', 'T', src_id, dst_id, 0xFF, 0xFF,
+	               file_size>>24, file_size>>16, file_size>>8, file_size, file_crc>>24, file_crc>>16, file_crc>>8, file_crc};
+	u8 *p;
+
+	*first = 0;
+	mmc_set_addr(MMC_CKPT_ADDR);
+	res = mmc_run_cmd(MMC_CMD_FREAD);
+	if ( res & 0xFFFF) {
+		xil_printf("copy_flash_file()::ERROR::Cannot read the copy checkpoint (error 0x%08X)\n\r", res);
+		return 1;
+	}
+	mmc_get_buffer(buf, MMC_FLASH_BUF_LEN);
+	blank = mmc_page_blank(buf);
+
+	if (memcmp(buf, hdr, sizeof(hdr)) == 0) {
+		for (k=0; CKPT_REC_OFFSET + (k+1)*CKPT_REC_LEN <= MMC_FLASH_BUF_LEN; k++) {
+			p = buf + CKPT_REC_OFFSET + k*CKPT_REC_LEN;
+			if (p[0] != 'S' || p[1] != k) break;
+			crc = buf8_to_32((p+4));
+		}
+		n = k;
+	}
+
+	/* cheap check of the recorded sectors: their last page shall match the source */
+	for (k=0; k<n; k++) {
+		last = (k+1)*PAGES_PER_SECTOR;
+		if (last > npages) last = npages;
+		last--;
+		if (read_page(dst_adr + last*MMC_FLASH_BUF_LEN, page_buf)) return 1;
+		if (read_page(src_adr + last*MMC_FLASH_BUF_LEN, buf)) return 1;
+		if (memcmp(buf, page_buf, MMC_FLASH_BUF_LEN)) {
+			xil_printf("copy_flash_file()::WARNING::Sector %d differs from the checkpoint, restarting\n\r", k);
+			n = 0;
+		}
+	}
+
+	if (n) {
+		xil_printf("copy_flash_file()::INFO::Resuming from sector %d\n\r", n);
+		*first = n;
+		copy_stats.crc = crc;
+		crc_adr = src_adr + n*FLASH_SECTOR_SIZE;
+		return 0;
+	}
+
+	/* new checkpoint */
+	if (!blank) {
+		if (erase_sector(MMC_CKPT_ADDR)) return 1;
+	}
+	return ckpt_program(0, hdr, sizeof(hdr), buf);
+}
+
+/* page I of NPAGES is done, record the sector when it is complete */
+static int page_done(u16 i, u16 npages, u8 *buf) {
+	sched_job_progress(i+1);
+	if ((i+1) % PAGES_PER_SECTOR && i+1 != npages) return 0;
+
+	if (ckpt_sector(i/PAGES_PER_SECTOR, buf)) return 1;
+	if (i+1 == npages || !sched_cancelled()) return 0;
+
+	xil_printf("\n\rcopy_flash_file()::INFO::Cancelled after %d pages, run the copy again to resume\n\r", i+1);
+	return 1;
+}
+
+/* copy NPAGES pages from SRC_ADR to the sector aligned DST_ADR, starting from sector FIRST
+ *  All the destination sectors are erased first, then pages are only read and
+ *  programmed. The commands are serialized by the MMC, but the buffers can be
+ *  accessed while a command runs: during the erase of sector N the page read
+ *  just before it is fetched from the read buffer and uploaded to the write
+ *  buffer, and programmed into the already erased sector FIRST when the erase is
+ *  done. An MMC that stretches the clock while busy makes this sequential again.
+ *  BUF: local page buffer, 4 bytes aligned
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int copy_planned(u32 src_adr, u32 dst_adr, u16 npages, u16 first, u8 *buf) {
+	u32 nsectors, s, res;
+	u16 i = first*PAGES_PER_SECTOR, blank = 0;
+
+	nsectors = ((u32)npages*MMC_FLASH_BUF_LEN + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+	if (first >= nsectors) return 0;
+	xil_printf("copy_flash_file()::INFO::Erasing %d sectors\n\r", nsectors - first);
+
+	for (s = first; s < nsectors; s++) {
+		if (s > first) {
+			/* bring the next page into the MMC's read buffer */
+			mmc_set_addr(src_adr + i*MMC_FLASH_BUF_LEN);
+			res = mmc_run_cmd(MMC_CMD_FREAD);
+			if ( res & 0xFFFF) {
+				xil_printf("\n\rcopy_flash_file()::ERROR::Could not read FLASH address 0x%08X\n\r", src_adr + i*MMC_FLASH_BUF_LEN);
+				return 1;
+			}
+			copy_stats.pages_read++;
+		}
+
+		erase_start(dst_adr + s*FLASH_SECTOR_SIZE);
+
+		if (s > first) {
+			/* erase running: move the page through the local buffer */
+			mmc_get_buffer(buf, MMC_FLASH_BUF_LEN);
+			crc_page(src_adr + i*MMC_FLASH_BUF_LEN, buf);
+			blank = mmc_page_blank(buf);
+			if (!blank) mmc_set_buffer(buf, MMC_FLASH_BUF_LEN);
+		}
+
+		if (erase_wait(dst_adr + s*FLASH_SECTOR_SIZE)) return 1;
+		copy_stats.sectors_erased++;
+
+		if (s > first) {
+			if (blank) {
+				copy_stats.pages_blank++;
+			} else {
+				if (prog_buffer(dst_adr + i*MMC_FLASH_BUF_LEN)) return 1;
+				copy_stats.pages_programmed++;
+			}
+			if (page_done(i, npages, buf)) return 1;
+			i++;
+		}
+	}
+
+	/* stream the remaining pages */
+	for (; i < npages; i++) {
+		if (read_page(src_adr + i*MMC_FLASH_BUF_LEN, buf)) return 1;
+		crc_page(src_adr + i*MMC_FLASH_BUF_LEN, buf);
+		if (prog_page(dst_adr + i*MMC_FLASH_BUF_LEN, buf)) return 1;
+		if (page_done(i, npages, buf)) return 1;
+	}
+
+	return 0;
+}
+
+/* File metadata cache
+ *  Size and CRC of the files 0..14 as stored in the info sectors of the
+ *  selected target (each target has its own cache). An entry is
+ *  loaded by the first request and dropped when this firmware runs a command
+ *  that can change it: WRLEN or CRC on the file, FERASE or FPROG in its info
+ *  sector (all of them when the address register is not known). file_info()
+ *  stores what it reads back.
+ */
+static void meta_touch(u16 cmd) {
+	u32 adr = tgt->shadow_addr;
+
+	if (!(tgt->shadow_valid & SHADOW_ADDR)) {
+		tgt->meta_valid = 0;
+	} else if (cmd == MMC_CMD_WRLEN || cmd == MMC_CMD_CRC) {
+		if (adr / FLASH_FILE_SIZE < FLASH_INFO_ID) tgt->meta_valid &= ~(1 << (adr / FLASH_FILE_SIZE));
+	} else if (adr >= info_addr(0)) {
+		adr = (adr - info_addr(0)) / FLASH_SECTOR_SIZE;
+		if (adr < FLASH_INFO_ID) tgt->meta_valid &= ~(1 << adr);
+	}
+}
+
+/* forget all the cached file metadata, e.g. when the flash was changed by someone else */
+void mmc_file_meta_invalidate(void) {
+	tgt->meta_valid = 0;
+}
+
+/* get the size and CRC of file ID, from the cache or from its info sector
+ *  An empty file has size 0xFFFFFFFF (erased info sector)
+ *
+ * returns: the metadata, NULL if ID is not valid or the info sector cannot be read
+ */
+const mmc_file_meta *mmc_file_meta_get(u8 id) {
+	u8  buf[12];
+	u32 res;
+
+	if (id >= FLASH_INFO_ID) return NULL;
+	if (tgt->meta_valid & (1 << id)) return &tgt->meta[id];
+
+	mmc_set_addr( info_addr(id) );
+	res = mmc_run_cmd(MMC_CMD_FREAD);
+	if ( res & 0xFFFF) {
+		xil_printf("mmc_file_meta_get()::ERROR::Cannot read info of file %d (error 0x%08X)\n\r", id, res);
+		return NULL;
+	}
+	mmc_get_buffer(buf, 12);
+	tgt->meta[id].size = buf8_to_32((buf+4));
+	tgt->meta[id].crc  = buf8_to_32((buf+8));
+	tgt->meta_valid |= 1 << id;
+
+	return &tgt->meta[id];
+}
+
+/* load the metadata of all the files not in the cache yet, in one pass
+ *
+ * returns: 0 on success, 1 on failure
+ */
+int mmc_file_meta_load(void) {
+	u8 id;
+	int ret = 0;
+
+	mmc_chain_begin();
+	for (id = 0; id < FLASH_INFO_ID; id++) {
+		if (!mmc_file_meta_get(id)) ret = 1;
+	}
+	mmc_chain_end();
+
+	return ret;
+}
+
+/* write the file length of file ID, let the MMC compute its CRC and compare it with FILE_CRC
+ *  BUF: local buffer of at least 12 bytes
+ *
+ * returns: 0 on success, 1 if a command failed, 2 if the CRC does not match
+ */
+static int file_info(u8 id, u32 file_size, u32 file_crc, u8 *buf) {
+	u32 res;
+
+	/* write file size */
+	mmc_chain_begin();
+	mmc_set_addr( id * FLASH_FILE_SIZE );
+	mmc_set_data(file_size);
+	mmc_start_seq(&seq_wrlen);
+	mmc_chain_end();
+	res = mmc_wait_cmd_res(MMC_CMD_WRLEN);
+	if ( res & 0xFFFF) {
+		xil_printf("copy_flash_file()::ERROR::Could not write destination file size\n\r");
+		return 1;
+	}
+
+	/* compute CRC */
+	xil_printf("copy_flash_file()::INFO::Computing CRC...");
+	res = mmc_run_seq(&seq_crc);
+	if ( res & 0xFFFF) {
+		xil_printf("ERROR::Could not compute destination file's CRC\n\r");
+		return 1;
+	} else {
+		xil_printf("DONE\n\r");
+	}
+
+	/* get computed CRC */
+	mmc_set_addr( info_addr(id) );
+	res = mmc_run_cmd(MMC_CMD_FREAD);
+	if ( res & 0xFFFF) {
+		xil_printf("copy_flash_file()::ERROR::Cannot read destination file info (error 0x%08X)\n\r", res);
+		return 1;
+	}
+	mmc_get_buffer(buf, 12);
+	tgt->meta[id].size = buf8_to_32((buf+4));
+	tgt->meta[id].crc  = buf8_to_32((buf+8));
+	tgt->meta_valid |= 1 << id;
+
+	/* compare source vs destination CRCs */
+	if (file_crc == tgt->meta[id].crc) {
+		xil_printf("copy_flash_file()::INFO::CRC check successful\n\r");
+	} else {
+		xil_printf("copy_flash_file()::ERROR::Destination file's CRC does not match the source file's CRC\n\r");
+		return 2;
+	}
+
+	return 0;
+}
+
+/* copy a file between different section of the FLASH memory
+ *  SRC_ID: ID of source file. File's address is calculated as 0x100000*ID. File size is fixed to 1MiB.
+ *  DST_ID: ID of destination file. File's address is calculated as 0x100000*ID. File size is fixed to 1MiB.
+ *          WARNING: This file will be erased and overwritten.
+ *  FLAGS : MMC_COPY_DIFF to erase and program only what differs from the current destination content
+ *          Without it the copy is checkpointed and an interrupted copy is resumed by the next call
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int flash_file_copy(u8 src_id, u8 dst_id, u8 flags) {
+	const mmc_file_meta *m;
+	u32 src_adr, dst_adr, file_size, file_crc, res;
+	u16 nbuffers, i, n;
+	static u8 rxbuf[256] __attribute__((aligned(4))); //aligned for mmc_page_blank(), not on the 1KiB stack
+
+	/* parameter checks */
+	if (src_id > 14 || dst_id > 14) {
+		xil_printf("copy_flash_file()::ERROR::Maximum allowed ID is 14\n\r");
+		return 1;
+	} else if (src_id == dst_id) {
+		xil_printf("copy_flash_file()::ERROR::Source ID shall be different from destination ID\n\r");
+		return 1;
+	}
+
+	/* compute addresses */
+	src_adr = src_id * FLASH_FILE_SIZE;
+	dst_adr = dst_id * FLASH_FILE_SIZE;
+
+	/* get file size and CRC */
+	m = mmc_file_meta_get(src_id);
+	if (!m) {
+		xil_printf("copy_flash_file()::ERROR::Cannot read source file info\n\r");
+		return 1;
+	}
+	file_size = m->size;
+	file_crc  = m->crc;
+	if (file_size > FLASH_FILE_SIZE) {
+		xil_printf("copy_flash_file()::ERROR::Source file is empty\n\r");
+		return 1;
+	}
+
+	/* compute number of buffers to write */
+	nbuffers = file_size / MMC_FLASH_BUF_LEN;
+	if (file_size % MMC_FLASH_BUF_LEN) nbuffers++; //one more if file is not an integer multiple of MMC_FLASH_BUF_LEN
+	xil_printf("copy_flash_file()::INFO::file_size = 0x%08X (%d buffers), CRC = 0x%08X\n\r", file_size, nbuffers, file_crc);
+	sched_job_begin("Progress", nbuffers);
+
+	/* the CRC of the data is computed while it goes through the local buffer */
+	copy_stats.crc = 0;
+	crc_adr = src_adr;
+	crc_end = src_adr + file_size;
+
+	if (flags & MMC_COPY_DIFF) {
+		/* one sector at a time */
+		for(i = 0; i < nbuffers; i += n) {
+			sched_job_progress(i);
+			if (sched_cancelled()) {
+				xil_printf("\n\rcopy_flash_file()::INFO::Cancelled after %d pages\n\r", i);
+				return 1;
+			}
+
+			n = FLASH_SECTOR_SIZE/MMC_FLASH_BUF_LEN;
+			if (n > nbuffers - i) n = nbuffers - i;
+			if (update_sector(src_adr, dst_adr, n, rxbuf)) return 1;
+
+			/* increment addresses for next sector */
+			src_adr += n*MMC_FLASH_BUF_LEN;
+			dst_adr += n*MMC_FLASH_BUF_LEN;
+		}
+	} else {
+		/* erase everything, then read and program, resuming an interrupted copy */
+		if (ckpt_open(src_id, dst_id, file_size, file_crc, nbuffers, &i, rxbuf)) return 1;
+		if (copy_planned(src_adr, dst_adr, nbuffers, i, rxbuf)) return 1;
+	}
+	xil_printf("\n\r");
+	xil_printf("copy_flash_file()::INFO::pages read %d, skipped %d, blank %d, programmed %d, sectors erased %d\n\r",
+		copy_stats.pages_read, copy_stats.pages_skipped, copy_stats.pages_blank, copy_stats.pages_programmed,
+		copy_stats.sectors_erased);
+
+	/* cross-check only: that crc32.c computes the CRC of MMC_CMD_CRC is not verified on
+	 * hardware yet, the CRC the MMC computes on the destination below is the check */
+	if (copy_stats.crc != file_crc) {
+		xil_printf("copy_flash_file()::WARNING::Copied data has CRC-32/IEEE 0x%08X, the source file 0x%08X\n\r", copy_stats.crc, file_crc);
+	}
+
+	/* write file size and CRC, the checkpoint is closed unless the MMC could not be reached */
+	res = file_info(dst_id, file_size, file_crc, rxbuf);
+	if (res != 1 && !(flags & MMC_COPY_DIFF) && ckpt_close(rxbuf)) return 1;
+
+	return (res ? 1 : 0);
+}
+
+/* copy a file between different section of the FLASH memory (see flash_file_copy)
+ *  All the register writes between two reads are chained with repeated STARTs
+ *
+ * returns: 0 on success, 1 on failure
+ */
+int mmc_flash_file_copy(u8 src_id, u8 dst_id, u8 flags) {
+	int ret;
+
+	memset(&copy_stats, 0, sizeof(copy_stats));
+	mmc_chain_begin();
+	ret = flash_file_copy(src_id, dst_id, flags);
+	mmc_chain_end();
+	sched_job_end();
+
+	return ret;
+}
+
+/* returns: page counters of the last mmc_flash_file_copy() */
+mmc_copy_stats *mmc_get_copy_stats(void) {
+	return &copy_stats;
+}
+
+/* write the file length of file ID and check the CRC computed by the MMC against FILE_CRC
+ *  The file data shall be already programmed
+ *
+ * returns: 0 on success, 1 on failure
+ */
+int mmc_flash_file_info(u8 id, u32 file_size, u32 file_crc) {
+	u8 buf[12];
+
+	if (id > 14) {
+		xil_printf("copy_flash_file()::ERROR::Maximum allowed ID is 14\n\r");
+		return 1;
+	}
+
+	return (file_info(id, file_size, file_crc, buf) ? 1 : 0);
+}
+
+/* Multi-target copy
+ *  The same file copy on several MMCs sharing the bus: like mmc_flash_file_copy()
+ *  without MMC_COPY_DIFF, but without checkpoint. Every target goes through its
+ *  own sequence of short steps: erase the destination sectors, then for every
+ *  page FREAD, move the read buffer to the write buffer and FPROG, last WRLEN,
+ *  CRC and the check of the stored CRC. A step ends by starting a command, and
+ *  while the command runs the bus serves the other targets: the pages of one
+ *  MMC are transferred while another erases or computes a CRC. A target is
+ *  polled once the learned latency of its command is over, not before, since
+ *  an MMC that stretches the clock while busy holds the whole bus.
+ */
+enum { MJ_ERASE, MJ_READ, MJ_PROG, MJ_WRLEN, MJ_CRC, MJ_CHECK, MJ_DONE, MJ_FAILED };
+
+typedef struct {
+	mmc_target *t;
+	u8  state;
+	u16 cmd;       //command running, MMC_CMD_COUNT if none
+	u32 t0;        //time the command was on the wire
+	u32 due;       //time its result is expected
+	u32 file_size;
+	u32 file_crc;
+	u32 crc;       //CRC of the source data read so far
+	u16 npages;
+	u16 nsectors;
+	u16 next;      //sector being erased, then page being copied
+} multi_job;
+
+static multi_job jobs[MMC_MAX_TARGETS]; //one per target of the running mmc_multi_copy(), not on the 1KiB stack
+static u8  multi_src, multi_dst; //file IDs of the running mmc_multi_copy()
+static u32 multi_pages;          //pages done on all the targets
+
+/* start the sequence S on the selected target of job J, joined to the register writes of an open chain */
+static void job_start(multi_job *j, const mmc_seq *s) {
+	mmc_start_seq(s);
+	mmc_chain_flush(MMC_BUS_STOP);
+	mmc_bus_flush();
+	j->cmd = s->cmd;
+	j->t0  = time_now_us();
+	j->due = j->t0 + cmd_expect_us(s->cmd);
+}
+
+static void job_fail(multi_job *j, const char *what, u32 adr) {
+	xil_printf("\n\rmmc_multi_copy()::ERROR::MMC 0x%02X: %s 0x%08X\n\r", j->t->addr7, what, adr);
+	j->state = MJ_FAILED;
+}
+
+/* page NEXT of job J is done: go on with the next page or with the file info */
+static void job_page_done(multi_job *j) {
+	sched_job_progress(++multi_pages);
+	if (++j->next < j->npages) {
+		j->state = MJ_READ;
+	} else {
+		if (j->crc != j->file_crc) { //cross-check only, see flash_file_copy
+			xil_printf("\n\rmmc_multi_copy()::WARNING::MMC 0x%02X: copied data has CRC-32/IEEE 0x%08X\n\r", j->t->addr7, j->crc);
+		}
+		copy_stats.crc = j->crc;
+		j->state = MJ_WRLEN;
+	}
+}
+
+/* run the next step of job J, its target is selected and no command is running */
+static void job_step(multi_job *j) {
+	const mmc_file_meta *m;
+
+	switch (j->state) {
+	case MJ_ERASE:
+		mmc_chain_begin();
+		mmc_set_addr(multi_dst*FLASH_FILE_SIZE + j->next*FLASH_SECTOR_SIZE);
+		job_start(j, &seq_ferase);
+		mmc_chain_end();
+		break;
+	case MJ_READ:
+		mmc_chain_begin();
+		mmc_set_addr(multi_src*FLASH_FILE_SIZE + j->next*MMC_FLASH_BUF_LEN);
+		job_start(j, &seq_fread);
+		mmc_chain_end();
+		break;
+	case MJ_WRLEN:
+		mmc_chain_begin();
+		mmc_set_addr(multi_dst*FLASH_FILE_SIZE);
+		mmc_set_data(j->file_size);
+		job_start(j, &seq_wrlen);
+		mmc_chain_end();
+		break;
+	case MJ_CRC:
+		job_start(j, &seq_crc);
+		break;
+	case MJ_CHECK:
+		m = mmc_file_meta_get(multi_dst);
+		if (!m) {
+			job_fail(j, "cannot read the info of file", multi_dst);
+		} else if (m->crc != j->file_crc) {
+			job_fail(j, "destination CRC does not match, it is", m->crc);
+		} else {
+			j->state = MJ_DONE;
+		}
+		break;
+	}
+}
+
+/* the command of job J completed with result RES, its target is selected
+ *  BUF: local page buffer, 4 bytes aligned
+ */
+static void job_done(multi_job *j, u32 res, u8 *buf) {
+	u32 n;
+
+	j->cmd = MMC_CMD_COUNT;
+	if (res & 0xFFFF) {
+		job_fail(j, "command failed, result", res);
+		return;
+	}
+
+	switch (j->state) {
+	case MJ_ERASE:
+		copy_stats.sectors_erased++;
+		if (++j->next == j->nsectors) {
+			j->state = MJ_READ;
+			j->next  = 0;
+		}
+		break;
+	case MJ_READ:
+		copy_stats.pages_read++;
+		mmc_get_buffer(buf, MMC_FLASH_BUF_LEN);
+		n = j->file_size - j->next*MMC_FLASH_BUF_LEN;
+		j->crc = crc32_update(j->crc, buf, (n > MMC_FLASH_BUF_LEN) ? MMC_FLASH_BUF_LEN : n);
+		if (mmc_page_blank(buf)) {
+			copy_stats.pages_blank++;
+			job_page_done(j);
+			break;
+		}
+		/* the page goes on at once: the local buffer is free for the next target */
+		mmc_set_buffer(buf, MMC_FLASH_BUF_LEN);
+		mmc_chain_begin();
+		mmc_set_addr(multi_dst*FLASH_FILE_SIZE + j->next*MMC_FLASH_BUF_LEN);
+		j->state = MJ_PROG;
+		job_start(j, &seq_fprog);
+		mmc_chain_end();
+		break;
+	case MJ_PROG:
+		copy_stats.pages_programmed++;
+		job_page_done(j);
+		break;
+	case MJ_WRLEN:
+		j->state = MJ_CRC;
+		break;
+	case MJ_CRC:
+		j->state = MJ_CHECK;
+		break;
+	}
+}
+
+/* copy file SRC_ID over file DST_ID on each of the N (1 to MMC_MAX_TARGETS) MMCs of TARGETS, interleaved on the bus
+ *  Every MMC copies its own source file. An MMC that fails is left behind, the others go on.
+ *  Ctrl-C (sched_cancel) stops all of them once their running commands are over.
+ *
+ * returns: 0 if the copy succeeded on all the MMCs, 1 otherwise
+ */
+int mmc_multi_copy(mmc_target **targets, u8 n, u8 src_id, u8 dst_id) {
+	multi_job *j, *ready, *first;
+	const mmc_file_meta *m;
+	mmc_target *prev;
+	u32 total = 0, res;
+	u8  *buf = page_buf; //the plain copy does not run meanwhile
+	u8  k, last = 0, cancelled = 0;
+	int ret = 0;
+
+	if (n == 0 || n > MMC_MAX_TARGETS || src_id > 14 || dst_id > 14 || src_id == dst_id) {
+		xil_printf("mmc_multi_copy()::ERROR::1 to %d MMCs, IDs 0 to 14 and different\n\r", MMC_MAX_TARGETS);
+		return 1;
+	}
+	for (k = 0; k < n; k++) {
+		if (!targets[k]) {
+			xil_printf("mmc_multi_copy()::ERROR::Target %d is not set\n\r", k);
+			return 1;
+		}
+	}
+	memset(&copy_stats, 0, sizeof(copy_stats));
+	multi_src   = src_id;
+	multi_dst   = dst_id;
+	multi_pages = 0;
+	prev = mmc_target_select(NULL);
+	mmc_chain_begin();
+
+	/* size and CRC of every source file, one target after the other */
+	for (k = 0; k < n; k++) {
+		j = &jobs[k];
+		memset(j, 0, sizeof(*j));
+		j->t   = targets[k];
+		j->cmd = MMC_CMD_COUNT;
+		mmc_target_select(j->t);
+		m = mmc_file_meta_get(src_id);
+		if (!m || m->size > FLASH_FILE_SIZE) {
+			job_fail(j, "no source file, ID", src_id);
+			continue;
+		}
+		j->file_size = m->size;
+		j->file_crc  = m->crc;
+		j->npages    = (m->size + MMC_FLASH_BUF_LEN - 1) / MMC_FLASH_BUF_LEN;
+		j->nsectors  = (m->size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+		if (j->nsectors == 0) j->state = MJ_WRLEN;
+		total += j->npages;
+	}
+	sched_job_begin("Progress", total);
+
+	for (;;) {
+		/* from the target after the last one served: the first idle one and the command due first */
+		ready = first = NULL;
+		for (k = 0; k < n; k++) {
+			j = &jobs[(last + 1 + k) % n];
+			if (j->cmd != MMC_CMD_COUNT) {
+				if (!first || time_before(j->due, first->due)) first = j;
+			} else if (j->state < MJ_DONE && !cancelled && !ready) {
+				ready = j;
+			}
+		}
+		if (!ready && !first) break;
+		if (!cancelled && sched_cancelled()) {
+			xil_printf("\n\rmmc_multi_copy()::INFO::Cancelled after %d pages\n\r", multi_pages);
+			cancelled = 1;
+			continue;
+		}
+
+		/* a command that is due frees its target, then new steps, else wait for the first command */
+		if (first && (!ready || !time_before(time_now_us(), first->due))) {
+			mmc_target_select(first->t);
+			res = wait_cmd_res(first->cmd, first->t0);
+			job_done(first, res, buf);
+			last = first - jobs;
+		} else {
+			mmc_target_select(ready->t);
+			job_step(ready);
+			last = ready - jobs;
+		}
+	}
+
+	mmc_chain_end();
+	mmc_target_select(prev);
+	sched_job_end();
+
+	xil_printf("\n\rmmc_multi_copy()::INFO::pages read %d, blank %d, programmed %d, sectors erased %d\n\r",
+		copy_stats.pages_read, copy_stats.pages_blank, copy_stats.pages_programmed, copy_stats.sectors_erased);
+	for (k = 0; k < n; k++) {
+		if (jobs[k].state == MJ_DONE) continue;
+		xil_printf("mmc_multi_copy()::ERROR::Copy on the MMC at 0x%02X did not complete\n\r", jobs[k].t->addr7);
+		ret = 1;
+	}
+	return ret;
+}
@@ -0,0 +1,167 @@
+#ifndef MMC_H
+#define MMC_H
+
+#include <xil_types.h>
+
+#define MMC_I2C_ADDR7 0x3E //MMC's I2C address (7-bits)
+#define MMC_MAX_TARGETS 8  //MMCs served together by mmc_multi_copy()
+
+/* MMC register map */
+#define MMC_XCMD_WREG        0x800 //execute command
+//#define MMC_CMD_RESULT_WREG  0x804 //result of last command, read only
+#define MMC_ADDR_WREG        0x808 //address used to read/write flash and SD-card
+#define MMC_DATA_WREG        0x80C //data register used by commands that need a data argument (eg: set file length)
+#define MMC_SECURE_KEY_WREG  0x810 //used to grant access to secured commands
+
+#define MMC_XCMD_RREG        0x900 //execute command
+#define MMC_CMD_RESULT_RREG  0x904 //result of last command
+#define MMC_ADDR_RREG        0x908 //address used to read/write flash and SD-card
+#define MMC_DATA_RREG        0x90C //data register used by commands that need a data argument (eg: set file length)
+#define MMC_SECURE_KEY_RREG  0x910 //used to grant access to secured commands
+
+#define MMC_FLASH_WBUF_ADDR 0x1000
+#define MMC_FLASH_RBUF_ADDR 0x1100
+
+/* other constants */
+#define MMC_SECURE_KEY      0x4F50454E //security key used to unlock commands (ASCII for 'OPEN')
+#define MMC_FLASH_BUF_LEN   256
+#define FLASH_SECTOR_SIZE   0x10000 //64KiB: minimum erasable size in MMC's FLASH
+#define FLASH_INFO_ID       15 //ID of 1MB Flash section reserved to store info on other 1MB sections
+#define FLASH_FILE_SIZE     0x100000 //FLASH is divided in 1MiB sections, one file per section
+#define MMC_CKPT_ADDR       info_addr(FLASH_INFO_ID) //spare sector of the info section (there is no file 15), holds the file copy checkpoint
+#define SD_SECTOR_SIZE      0x200 //SD card sector size. If only part of a sector is written, all the rest is erased.
+/* MMC command codes */
+#define MMC_CMD_NULL   0x0000 //no effect. can be used to read back the whole command register seciton
+#define MMC_CMD_FREAD  0x0001 //read 256B from FLASH's address stored in MMC_ADDR_REG. Data is stored at FLASH_RBUF_ADDR
+#define MMC_CMD_FERASE 0x0002 //erase a 64K FLASH sector starting from address MMC_ADDR_REG. Address shall be 64K aligned (n*0x10000)
+#define MMC_CMD_FPROG  0x0003 //Programs 256B into flash FLASH at address stored in MMC_ADDR_REG. Data is taken from FLASH_WBUF_ADDR
+#define MMC_CMD_IAP0   0x0004 //Executes IAP (MMC FW update) using firmware tored in FLASH at address 0x0
+#define MMC_CMD_IAP1   0x0005 //Executes IAP (MMC FW update) using firmware tored in FLASH at address 0x100000
+#define MMC_CMD_RESET  0x0006 //Resets MMC's CPU (causes a power cycle)
+#define MMC_CMD_SDREAD 0x0007 //read 256B from SDcard's address stored in MMC_ADDR_REG. Data is stored in FLASH_RBUF_ADDR
+#define MMC_CMD_SDPROG 0x0008 //write 256B to SDcard's address stored in MMC_ADDR_REG. Data is taken from FLASH_WBUF_ADDR
+#define MMC_CMD_TSD    0x0009 //Execute timed shutdown (switch off power supply for 5 seconds, then switch on again)
+#define MMC_CMD_WRLEN  0x000A //Write file length. Uses the file address from the ADDR register, and the length from the DATA register.
+#define MMC_CMD_CRC    0x000B //Compute CRC on file. Uses current address register to select file, and stored file length.
+#define MMC_CMD_COUNT  12
+
+#define MMC_RES_TIMEOUT 0xFFFF //result code reported by mmc_wait_cmd_res() when the command did not complete in time
+#define MMC_POLL_US     930    //shortest interval between result polls: one poll at 100kHz (about 93 SCL cycles)
+#define MMC_SEND16_US   1000   //time the MMC needs after a 16 bit transaction
+#define MMC_SPEED_PROBES 4     //reads of the command registers that a speed profile shall pass
+#define MMC_HIST_BINS   12     //completion time histogram: bin N counts the times below 64us<<N, the last one all the others
+
+/* completion statistics of one command code */
+typedef struct {
+	u32 count;    //completed commands
+	u32 timeouts;
+	u32 polls;    //result register reads
+	u32 min_us;
+	u32 max_us;
+	u32 total_us;
+	u32 next_us;  //learned delay before the first poll
+	u32 hist[MMC_HIST_BINS];
+} mmc_cmd_stats;
+
+/* totals of the mmc_* layer, see mmc_print_stats() */
+typedef struct {
+	u32 pages_rx;  //full buffers read from the MMC
+	u32 pages_tx;  //full buffers written to the MMC
+	u32 wait_us;   //time spent waiting between result polls
+} mmc_io_stats;
+
+/* mmc_flash_file_copy() flags */
+#define MMC_COPY_DIFF 0x01 //compare with the destination, erase and program only what differs
+
+/* page counters of the last file copy */
+typedef struct {
+	u32 pages_read;       //FREAD commands, source and destination
+	u32 pages_skipped;    //destination pages left as they were
+	u32 pages_blank;      //all 0xFF pages not sent nor programmed
+	u32 pages_programmed;
+	u32 sectors_erased;
+	u32 crc;              //CRC-32 of the source data as read over the bus
+	u32 checkpoints;      //checkpoint records programmed
+} mmc_copy_stats;
+
+/* size and CRC of a file, as stored in its info sector */
+typedef struct {
+	u32 size; //0xFFFFFFFF if the info sector is erased
+	u32 crc;
+} mmc_file_meta;
+
+/* one MMC on the bus: its I2C address and what the driver knows of its state,
+ * see mmc_target_select()
+ */
+typedef struct {
+	u8  addr7;
+	u8  shadow_valid;   //which of the shadowed registers are known
+	u32 shadow_addr;
+	u32 shadow_data;
+	u32 shadow_key;
+	u16 last_cmd;       //code of the last command written to MMC_XCMD_WREG
+	u8  last_read;      //the result of LAST_CMD was read back
+	u8  send16_pending;
+	u32 send16_ready;   //timestamp after which the MMC accepts the next transaction
+	u16 meta_valid;     //bit N: META[N] is loaded
+	mmc_file_meta meta[FLASH_INFO_ID];
+} mmc_target;
+
+/* constant command sequence, sent from pre-encoded frames by mmc_start_seq() */
+typedef struct {
+	u16 cmd;    //command code, below MMC_CMD_COUNT
+	u8  unlock; //send the secure key first (nothing is sent while it is still loaded)
+} mmc_seq;
+
+#define buf8_to_16(x) ((x[0]<<8) | x[1])
+#define buf8_to_32(x) ((x[0]<<24) | (x[1]<<16) | (x[2]<<8) | x[3] )
+#define info_addr(x)  ((FLASH_INFO_ID * FLASH_FILE_SIZE) + (x * FLASH_SECTOR_SIZE))
+
+void mmc_target_init(mmc_target *t, u8 addr7);
+mmc_target *mmc_target_select(mmc_target *t);
+mmc_target *mmc_target_get(void);
+void mmc_send16(u8 c1, u8 c2);
+void mmc_chain_begin(void);
+void mmc_chain_end(void);
+void mmc_chain_enable(int on);
+u32 mmc_chain_rstarts(void);
+unsigned mmc_send32(u16 addr, u16 data);
+unsigned mmc_read(u8 *rxbuf, u16 n);
+unsigned mmc_execute_cmd(u16 cmd);
+void mmc_set_stretch(int on);
+void mmc_shadow_invalidate(void);
+u32 mmc_shadow_skipped(void);
+unsigned mmc_set_addr(u32 addr);
+u32 mmc_get_addr(void);
+void mmc_set_data(u32 data);
+u32 mmc_get_data(void);
+u32 mmc_get_cmd_res(void);
+u32 mmc_wait_cmd_res(u16 cmd);
+unsigned mmc_start_cmd(u16 cmd);
+u32 mmc_run_cmd(u16 cmd);
+unsigned mmc_start_seq(const mmc_seq *s);
+u32 mmc_run_seq(const mmc_seq *s);
+mmc_cmd_stats *mmc_get_cmd_stats(u16 cmd);
+void mmc_reset_cmd_stats(void);
+void mmc_print_cmd_stats(void);
+mmc_io_stats *mmc_get_io_stats(void);
+u32 mmc_stats_time_us(void);
+void mmc_reset_stats(void);
+void mmc_print_stats(void);
+u8 mmc_speed_negotiate(u8 max_speed);
+u8 mmc_speed_recover(u8 max_speed);
+unsigned mmc_get_buffer(u8 *buf, u16 n);
+unsigned mmc_set_buffer(u8 *buf, u16 n);
+unsigned mmc_get_cmd_regs(u8 *buf);
+void mmc_display_buffer(u8 *buf, u16 n);
+void mmc_unlock(void);
+int mmc_page_blank(const u8 *buf);
+int mmc_flash_file_copy(u8 src_id, u8 dst_id, u8 flags);
+int mmc_flash_file_info(u8 id, u32 file_size, u32 file_crc);
+int mmc_multi_copy(mmc_target **targets, u8 n, u8 src_id, u8 dst_id);
+mmc_copy_stats *mmc_get_copy_stats(void);
+const mmc_file_meta *mmc_file_meta_get(u8 id);
+int mmc_file_meta_load(void);
+void mmc_file_meta_invalidate(void);
+
+#endif // MMC_H
@@ -0,0 +1,158 @@
+#include "mmc_bus.h"
+#include <xparameters.h>
+#include "mmc_xfer.h"
+#include "delay.h"
+#include <string.h>
+
+static mmc_bus_stats stats;
+static u32 scl_hz = MMC_BUS_SCL_HZ;
+static u32 scl_ns = 1000000000 / MMC_BUS_SCL_HZ; //SCL period
+static u8  speed  = MMC_BUS_SPEED_SM;
+#if MMC_BUS_BACKEND == MMC_BUS_IRQ
+static u32 errors0 = 0; //mmc_xfer_errors() at the last mmc_bus_reset_stats()
+#endif
+
+/* times in ns of the timing registers, I2C-bus specification (UM10204) minimums
+ * except SCL high and low, which make the whole period */
+typedef struct {
+	u32 hz;
+	u16 t_ns[MMC_BUS_TIMING_REGS]; //TSUSTA TSUSTO THDSTA TSUDAT TBUF THIGH TLOW THDDAT
+} bus_speed;
+
+static const bus_speed speeds[MMC_BUS_SPEED_COUNT] = {
+	{ 100000, {4700, 4000, 4000, 250, 4700, 5000, 5000, 300}},
+	{ 400000, { 600,  600,  600, 100, 1300, 1200, 1300, 300}},
+	{1000000, { 260,  260,  260,  50,  500,  500,  500,   0}},
+};
+
+/* account the wire time of one transaction of N data bytes, also on the timebase */
+static void count(unsigned n, u8 option)
+{
+	u32 cycles = 9 * (n + 1) + 2;
+
+	stats.scl_cycles += cycles;
+	time_advance_ns(cycles * scl_ns);
+	if (option == MMC_BUS_REPEATED_START) stats.rstarts++;
+}
+
+int mmc_bus_init(void)
+{
+	speed = MMC_BUS_SPEED_SM; //the core is reset to its default timing
+#if MMC_BUS_BACKEND == MMC_BUS_IRQ
+	return mmc_xfer_init();
+#elif MMC_BUS_BACKEND == MMC_BUS_FIFO
+	iic_fifo_init(XPAR_AXI_IIC_0_BASEADDR);
+	return 0;
+#else
+	return 0;
+#endif
+}
+
+static unsigned send(u8 addr7, u8 *buf, unsigned n, u8 option)
+{
+	unsigned ret;
+
+#if MMC_BUS_BACKEND == MMC_BUS_IRQ
+	ret = mmc_xfer_send(addr7, buf, n, option);
+#elif MMC_BUS_BACKEND == MMC_BUS_FIFO
+	ret = iic_fifo_send(XPAR_AXI_IIC_0_BASEADDR, addr7, buf, n, option);
+#else
+	ret = XIic_Send(XPAR_AXI_IIC_0_BASEADDR, addr7, buf, n, option);
+#endif
+	stats.sends++;
+	stats.bytes_tx += n;
+	if (ret < n) stats.short_tx++;
+	count(n, option);
+
+	return ret;
+}
+
+static unsigned recv(u8 addr7, u8 *buf, unsigned n, u8 option)
+{
+	unsigned ret;
+
+#if MMC_BUS_BACKEND == MMC_BUS_IRQ
+	ret = mmc_xfer_recv(addr7, buf, n, option);
+#elif MMC_BUS_BACKEND == MMC_BUS_FIFO
+	ret = iic_fifo_recv(XPAR_AXI_IIC_0_BASEADDR, addr7, buf, n, option);
+#else
+	ret = XIic_Recv(XPAR_AXI_IIC_0_BASEADDR, addr7, buf, n, option);
+#endif
+	stats.recvs++;
+	stats.bytes_rx += n;
+	if (ret < n) stats.short_rx++;
+	count(n, option);
+
+	return ret;
+}
+
+unsigned mmc_bus_send(u8 addr7, u8 *buf, unsigned n, u8 option)
+{
+	return send(addr7, buf, n, option);
+}
+
+unsigned mmc_bus_recv(u8 addr7, u8 *buf, unsigned n, u8 option)
+{
+	return recv(addr7, buf, n, option);
+}
+
+void mmc_bus_flush(void)
+{
+#if MMC_BUS_BACKEND == MMC_BUS_IRQ
+	mmc_xfer_flush();
+#endif
+}
+
+mmc_bus_stats *mmc_bus_get_stats(void)
+{
+#if MMC_BUS_BACKEND == MMC_BUS_IRQ
+	stats.errors = mmc_xfer_errors() - errors0; //the queued writes report their NACK here only
+#endif
+	return &stats;
+}
+
+void mmc_bus_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+#if MMC_BUS_BACKEND == MMC_BUS_IRQ
+	errors0 = mmc_xfer_errors();
+#endif
+}
+
+void mmc_bus_set_scl_hz(u32 hz)
+{
+	scl_hz = hz;
+	scl_ns = 1000000000 / hz;
+}
+
+u32 mmc_bus_get_scl_hz(void)
+{
+	return scl_hz;
+}
+
+int mmc_bus_set_speed(u8 sp)
+{
+	const bus_speed *p;
+	u32 v, ofs;
+	u8  i;
+
+	if (sp >= MMC_BUS_SPEED_COUNT) return 1;
+	p = &speeds[sp];
+
+	/* PG090: SCL high lasts THIGH + 7 cycles (input synchronizers), the other times the value + 1 */
+	mmc_bus_flush();
+	for (i = 0; i < MMC_BUS_TIMING_REGS; i++) {
+		v   = (p->t_ns[i] * (MMC_BUS_AXI_HZ / 1000000)) / 1000;
+		ofs = (MMC_BUS_TSUSTA_OFFSET + 4*i == MMC_BUS_THIGH_OFFSET) ? 7 : 1;
+		XIic_WriteReg(XPAR_AXI_IIC_0_BASEADDR, MMC_BUS_TSUSTA_OFFSET + 4*i, (v > ofs) ? v - ofs : 0);
+	}
+	speed = sp;
+	mmc_bus_set_scl_hz(p->hz);
+
+	return 0;
+}
+
+u8 mmc_bus_get_speed(void)
+{
+	return speed;
+}
@@ -0,0 +1,111 @@
+/*
+ * Info   : Thin I2C bus HAL used by the MMC access layer (mmc.c).
+ *          All traffic towards the MMC goes through these two calls, so the
+ *          backend (AXI IIC on the board, simulator on the host) can be
+ *          swapped without touching the mmc_* functions.
+ */
+
+#ifndef MMC_BUS_H
+#define MMC_BUS_H
+
+#include <xil_types.h>
+#include "xiic_l.h"
+#include "iic_fifo.h"
+
+/* transaction termination options (same meaning as the XIic_Send/Recv ones) */
+#define MMC_BUS_STOP           XIIC_STOP           //release the bus with a STOP condition
+#define MMC_BUS_REPEATED_START XIIC_REPEATED_START //keep the bus, next transaction starts with a repeated START
+
+/* bus backends */
+#define MMC_BUS_POLLED 0 //XIic_Send/XIic_Recv, the CPU waits for every byte
+#define MMC_BUS_IRQ    1 //interrupt driven transaction queue (mmc_xfer.c)
+#define MMC_BUS_FIFO   2 //polled, FIFO-depth-aware dynamic mode driver (iic_fifo.c)
+
+#ifndef MMC_BUS_BACKEND
+#define MMC_BUS_BACKEND MMC_BUS_IRQ
+#endif
+
+/* longest read the backend can do in one transaction */
+#if MMC_BUS_BACKEND == MMC_BUS_FIFO
+#define MMC_BUS_MAX_READ IIC_FIFO_MAX_READ
+#else
+#define MMC_BUS_MAX_READ 0xFFFF
+#endif
+
+/* default SCL rate of the AXI IIC core, see mmc_bus_set_scl_hz() */
+#define MMC_BUS_SCL_HZ 100000
+
+/* SCL speed profiles, see mmc_bus_set_speed() */
+#define MMC_BUS_SPEED_SM    0 //standard mode, 100 kHz (the core's default after reset)
+#define MMC_BUS_SPEED_FM    1 //fast mode, 400 kHz
+#define MMC_BUS_SPEED_FMP   2 //fast mode plus, 1 MHz
+#define MMC_BUS_SPEED_COUNT 3
+
+/* s_axi_aclk of axi_iic_0, the timing registers count its cycles */
+#ifndef MMC_BUS_AXI_HZ
+#define MMC_BUS_AXI_HZ 125000000
+#endif
+
+/* timing registers of the AXI IIC core (PG090), in this order */
+#define MMC_BUS_TSUSTA_OFFSET 0x128
+#define MMC_BUS_THIGH_OFFSET  0x13C
+#define MMC_BUS_TIMING_REGS   8     //TSUSTA TSUSTO THDSTA TSUDAT TBUF THIGH TLOW THDDAT
+
+/* transaction counters, the same for every backend and for the host build */
+typedef struct {
+	u32 sends;      //write transactions
+	u32 recvs;      //read transactions
+	u32 bytes_tx;   //data bytes requested to be written
+	u32 bytes_rx;   //data bytes requested to be read
+	u32 short_tx;   //writes that sent less than requested (NACK, arbitration lost), see errors for the interrupt backend
+	u32 short_rx;   //reads that received less than requested
+	u32 errors;     //transactions the interrupt backend completed with a NACK or arbitration lost
+	u32 rstarts;    //transactions ended with a repeated START instead of STOP
+	u32 scl_cycles; //estimated wire time in SCL cycles: START, address and data bytes, STOP
+	u32 fallbacks;  //speed profile lowered by mmc_speed_recover()
+} mmc_bus_stats;
+
+/* Setup the bus backend. Shall be called once before any other mmc_bus_* call
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int mmc_bus_init(void);
+
+/* Write N bytes to the I2C slave ADDR7
+ *  With the interrupt backend the write is only queued: BUF shall stay valid
+ *  until the next read or mmc_bus_flush() if N is bigger than MMC_XFER_INLINE
+ *  A short transaction is counted but leaves the speed profile alone, the
+ *  same for the reads: a NACK also comes from an MMC that is rebooting or
+ *  absent, see mmc_speed_recover()
+ *
+ *  returns: the number of bytes sent (shall be N)
+ */
+unsigned mmc_bus_send(u8 addr7, u8 *buf, unsigned n, u8 option);
+
+/* Read N bytes (maximum MMC_BUS_MAX_READ) from the I2C slave ADDR7
+ *
+ *  returns: the number of bytes received (shall be N)
+ */
+unsigned mmc_bus_recv(u8 addr7, u8 *buf, unsigned n, u8 option);
+
+/* wait until all the queued transactions are on the wire */
+void mmc_bus_flush(void);
+
+/* returns: the counters, the errors of the interrupt backend updated */
+mmc_bus_stats *mmc_bus_get_stats(void);
+void mmc_bus_reset_stats(void);
+
+/* SCL rate used to turn the SCL cycles into time (it does not program the core) */
+void mmc_bus_set_scl_hz(u32 hz);
+u32 mmc_bus_get_scl_hz(void);
+
+/* Program the timing registers of the core for the speed profile SPEED
+ *  The times follow the I2C-bus specification for the mode, SCL high plus low
+ *  time make the nominal period. The SCL rate of the statistics is set too
+ *
+ *  returns: 0 on success, 1 if SPEED is not a profile
+ */
+int mmc_bus_set_speed(u8 speed);
+u8 mmc_bus_get_speed(void);
+
+#endif // MMC_BUS_H
@@ -0,0 +1,212 @@
+#include "mmc_xfer.h"
+#include <string.h>
+#include <xparameters.h>
+#include "xiic.h"
+#include "xintc.h"
+#include "xil_exception.h"
+#include "mmc_bus.h"
+#include "delay.h"
+
+typedef struct {
+	u8  addr7;
+	u8  read;
+	u8  option;
+	u8  data[MMC_XFER_INLINE];
+	u8 *buf;
+	u16 n;
+} mmc_xfer;
+
+static XIic  iic;
+static XIntc intc;
+
+static mmc_xfer queue[MMC_XFER_QUEUE_LEN];
+static volatile u32 submitted = 0; //sequence number of the next queued transaction
+static volatile u32 completed = 0; //number of finished transactions
+static volatile int active = 0;    //a transaction is on the bus
+static volatile u32 errors = 0;
+static volatile u16 last_len = 0;  //bytes transferred by the last finished transaction
+
+static void finish(u16 len, int error);
+
+/* start the transaction at the head of the queue if the bus is idle
+ *  From the completion interrupt the bus is often still busy with the STOP
+ *  just sent: the driver refuses the start and enables the bus not busy
+ *  interrupt, status_handler() calls this again then
+ */
+static void start_next(void)
+{
+	mmc_xfer *x;
+	u32 options;
+	int ret;
+
+	if (active || completed == submitted) return;
+
+	x = &queue[completed % MMC_XFER_QUEUE_LEN];
+	active = 1;
+
+	options = XIic_GetOptions(&iic) & ~XII_REPEATED_START_OPTION;
+	if (x->option == MMC_BUS_REPEATED_START) options |= XII_REPEATED_START_OPTION;
+	XIic_SetOptions(&iic, options);
+	XIic_SetAddress(&iic, XII_ADDR_TO_SEND_TYPE, x->addr7);
+
+	if (x->read) {
+		ret = XIic_MasterRecv(&iic, x->buf, x->n);
+	} else {
+		ret = XIic_MasterSend(&iic, (x->n <= MMC_XFER_INLINE) ? x->data : x->buf, x->n);
+	}
+	if (ret == XST_IIC_BUS_BUSY) {
+		active = 0; //restarted by the bus not busy event
+	} else if (ret != XST_SUCCESS) {
+		finish(0, 1);
+	}
+}
+
+/* called from interrupt context when the transaction on the bus is over */
+static void finish(u16 len, int error)
+{
+	if (!active) return; //dropped by a timeout meanwhile
+	if (error) errors++;
+	last_len = len;
+	completed++;
+	active = 0;
+	start_next();
+}
+
+static void send_handler(void *ref, int remaining)
+{
+	mmc_xfer *x = &queue[completed % MMC_XFER_QUEUE_LEN];
+
+	(void)ref;
+	finish(x->n - remaining, remaining != 0);
+}
+
+static void recv_handler(void *ref, int remaining)
+{
+	mmc_xfer *x = &queue[completed % MMC_XFER_QUEUE_LEN];
+
+	(void)ref;
+	finish(x->n - remaining, remaining != 0);
+}
+
+static void status_handler(void *ref, int event)
+{
+	(void)ref;
+	if (event & (XII_SLAVE_NO_ACK_EVENT | XII_ARB_LOST_EVENT)) {
+		finish(0, 1);
+	}
+	if (event & XII_BUS_NOT_BUSY_EVENT) {
+		start_next();
+	}
+}
+
+/* give up all the queued transactions, they count as errors */
+static void drop(void)
+{
+	Xil_ExceptionDisable();
+	errors   += submitted - completed;
+	completed = submitted;
+	active    = 0;
+	Xil_ExceptionEnable();
+}
+
+/* wait until the transaction SEQ and the ones before it are finished
+ *  The queue is dropped if it does not get there in MMC_XFER_TIMEOUT_MS
+ *
+ *  returns: 0 on success, 1 on timeout
+ */
+static int wait_done(u32 seq)
+{
+	u32 polls;
+
+	for (polls = 0; (s32)(completed - seq) <= 0; polls++) {
+		if (polls >= (MMC_XFER_TIMEOUT_MS * 1000) / MMC_XFER_POLL_US) {
+			drop();
+			return 1;
+		}
+		spin_us(MMC_XFER_POLL_US);
+	}
+
+	return 0;
+}
+
+/* add a transaction to the queue and kick the engine if it is idle
+ *
+ *  returns: sequence number of the transaction
+ */
+static u32 submit(u8 addr7, u8 read, u8 *buf, unsigned n, u8 option)
+{
+	mmc_xfer *x;
+	u32 seq;
+
+	if (submitted - completed >= MMC_XFER_QUEUE_LEN) {
+		wait_done(submitted - MMC_XFER_QUEUE_LEN); //queue full, wait for the interrupt to free a slot
+	}
+
+	x = &queue[submitted % MMC_XFER_QUEUE_LEN];
+	x->addr7  = addr7;
+	x->read   = read;
+	x->option = option;
+	x->buf    = buf;
+	x->n      = n;
+	if (!read && n <= MMC_XFER_INLINE) memcpy(x->data, buf, n);
+
+	Xil_ExceptionDisable();
+	seq = submitted++;
+	start_next();
+	Xil_ExceptionEnable();
+
+	return seq;
+}
+
+int mmc_xfer_init(void)
+{
+	if (XIic_Initialize(&iic, XPAR_IIC_0_DEVICE_ID) != XST_SUCCESS) return 1;
+	XIic_SetSendHandler(&iic, &iic, (XIic_Handler)send_handler);
+	XIic_SetRecvHandler(&iic, &iic, (XIic_Handler)recv_handler);
+	XIic_SetStatusHandler(&iic, &iic, (XIic_StatusHandler)status_handler);
+
+	if (XIntc_Initialize(&intc, XPAR_INTC_0_DEVICE_ID) != XST_SUCCESS) return 1;
+	if (XIntc_Connect(&intc, XPAR_INTC_0_IIC_0_VEC_ID,
+			(XInterruptHandler)XIic_InterruptHandler, &iic) != XST_SUCCESS) return 1;
+	if (XIntc_Start(&intc, XIN_REAL_MODE) != XST_SUCCESS) return 1;
+	XIntc_Enable(&intc, XPAR_INTC_0_IIC_0_VEC_ID);
+
+	Xil_ExceptionInit();
+	Xil_ExceptionRegisterHandler(XIL_EXCEPTION_ID_INT,
+			(Xil_ExceptionHandler)XIntc_InterruptHandler, &intc);
+	Xil_ExceptionEnable();
+
+	if (XIic_Start(&iic) != XST_SUCCESS) return 1;
+
+	return 0;
+}
+
+unsigned mmc_xfer_send(u8 addr7, u8 *buf, unsigned n, u8 option)
+{
+	submit(addr7, 0, buf, n, option);
+	return n;
+}
+
+unsigned mmc_xfer_recv(u8 addr7, u8 *buf, unsigned n, u8 option)
+{
+	u32 seq = submit(addr7, 1, buf, n, option);
+
+	if (wait_done(seq)) return 0; //this read and the writes queued before it
+
+	return last_len;
+}
+
+void mmc_xfer_flush(void)
+{
+	wait_done(submitted - 1);
+}
+
+int mmc_xfer_busy(void)
+{
+	return (completed != submitted);
+}
+
+u32 mmc_xfer_errors(void)
+{
+	return errors;
+}
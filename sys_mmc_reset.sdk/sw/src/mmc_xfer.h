@@ -0,0 +1,53 @@
+/*
+ * Info   : Interrupt driven I2C transfer engine.
+ *          Transactions are queued and started from the axi_iic interrupt
+ *          (routed through axi_intc_0), so writes return as soon as they are
+ *          queued and the CPU can prepare the next data while the bus is busy.
+ *          A read waits for all the transactions queued before it.
+ */
+
+#ifndef MMC_XFER_H
+#define MMC_XFER_H
+
+#include <xil_types.h>
+
+#define MMC_XFER_QUEUE_LEN 16 //number of queued transactions
+#define MMC_XFER_INLINE    4  //writes up to this size are copied into the queue
+#define MMC_XFER_POLL_US   10 //check interval of the waits for the queue
+
+/* the waits for the queue give up after this time: the MMC stretches a
+ * transaction while a command runs, the CRC of a whole file for up to 10 s */
+#define MMC_XFER_TIMEOUT_MS 15000
+
+/* Setup IIC driver, interrupt controller and MicroBlaze interrupts
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int mmc_xfer_init(void);
+
+/* Queue a write transaction
+ *  BUF is copied if N <= MMC_XFER_INLINE, otherwise it shall stay valid
+ *  until the transaction is done (see mmc_xfer_flush). If the queue does not
+ *  move for MMC_XFER_TIMEOUT_MS, all the queued transactions are dropped and
+ *  counted as errors, the same in the other waits
+ *
+ *  returns: N (errors are reported by mmc_xfer_errors)
+ */
+unsigned mmc_xfer_send(u8 addr7, u8 *buf, unsigned n, u8 option);
+
+/* Queue a read transaction and wait for it
+ *
+ *  returns: the number of bytes received (shall be N, 0 on timeout)
+ */
+unsigned mmc_xfer_recv(u8 addr7, u8 *buf, unsigned n, u8 option);
+
+/* wait until all queued transactions are done */
+void mmc_xfer_flush(void);
+
+/* returns: 1 while transactions are queued or running */
+int mmc_xfer_busy(void);
+
+/* returns: number of transactions that failed (NACK, arbitration lost, timeout) since init */
+u32 mmc_xfer_errors(void);
+
+#endif // MMC_XFER_H
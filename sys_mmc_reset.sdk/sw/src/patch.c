@@ -0,0 +1,129 @@
+#include "patch.h"
+#include <string.h>
+#include "mmc.h"
+
+enum { HEADER, OP, COPY_ARGS, INSERT_ARGS, INSERT_DATA, DONE };
+
+void patch_init(patch_state *p, patch_read_fn read, patch_emit_fn emit)
+{
+	p->src_page = 0xFFFFFFFF;
+	p->pos      = 0;
+	p->len      = 0;
+	p->state    = HEADER;
+	p->n        = 0;
+	p->read     = read;
+	p->emit     = emit;
+}
+
+/* append N bytes to the output, hand out the page when it is full
+ *  N shall not go past the end of the output page
+ */
+static int out(patch_state *p, const u8 *buf, u32 n)
+{
+	memcpy(p->out + p->pos % PATCH_PAGE, buf, n);
+	p->pos += n;
+	if (p->pos % PATCH_PAGE) return 0;
+
+	return p->emit(p->out, PATCH_PAGE);
+}
+
+/* run a whole COPY operation */
+static int copy(patch_state *p)
+{
+	u32 n, page;
+
+	while (p->len) {
+		page = p->offset & ~(PATCH_PAGE - 1);
+		if (page != p->src_page) {
+			if (p->read(page, p->src)) return 1;
+			p->src_page = page;
+		}
+		n = PATCH_PAGE - (p->offset % PATCH_PAGE);
+		if (n > PATCH_PAGE - (p->pos % PATCH_PAGE)) n = PATCH_PAGE - (p->pos % PATCH_PAGE);
+		if (n > p->len) n = p->len;
+
+		if (out(p, p->src + p->offset % PATCH_PAGE, n)) return 1;
+		p->offset += n;
+		p->len    -= n;
+	}
+	p->state = OP;
+	return 0;
+}
+
+int patch_feed(patch_state *p, const u8 *in, u32 n)
+{
+	u32 k;
+	u8  c;
+
+	while (n) {
+		switch (p->state) {
+		case HEADER:
+			p->hdr[p->n++] = *in++;
+			n--;
+			if (p->n < PATCH_HDR_LEN) break;
+			if (buf8_to_32(p->hdr) != PATCH_MAGIC) return 1;
+			p->src_size = buf8_to_32((p->hdr+4));
+			p->src_crc  = buf8_to_32((p->hdr+8));
+			p->new_size = buf8_to_32((p->hdr+12));
+			p->new_crc  = buf8_to_32((p->hdr+16));
+			p->state    = OP;
+			break;
+		case OP:
+			c = *in++;
+			n--;
+			p->n = 0;
+			if (c == PATCH_OP_END) {
+				p->state = DONE;
+			} else if (c == PATCH_OP_COPY) {
+				p->state = COPY_ARGS;
+			} else if (c == PATCH_OP_INSERT) {
+				p->state = INSERT_ARGS;
+			} else {
+				return 1;
+			}
+			break;
+		case COPY_ARGS:
+			p->hdr[p->n++] = *in++;
+			n--;
+			if (p->n < 6) break;
+			p->offset = (p->hdr[0] << 16) | (p->hdr[1] << 8) | p->hdr[2];
+			p->len    = (p->hdr[3] << 16) | (p->hdr[4] << 8) | p->hdr[5];
+			if (p->offset + p->len > p->src_size || p->pos + p->len > p->new_size) return 1;
+			if (copy(p)) return 1;
+			break;
+		case INSERT_ARGS:
+			p->hdr[p->n++] = *in++;
+			n--;
+			if (p->n < 2) break;
+			p->len = buf8_to_16(p->hdr);
+			if (p->pos + p->len > p->new_size) return 1;
+			p->state = p->len ? INSERT_DATA : OP;
+			break;
+		case INSERT_DATA:
+			k = PATCH_PAGE - (p->pos % PATCH_PAGE);
+			if (k > p->len) k = p->len;
+			if (k > n) k = n;
+			if (out(p, in, k)) return 1;
+			in += k;
+			n  -= k;
+			p->len -= k;
+			if (p->len == 0) p->state = OP;
+			break;
+		default: //nothing after END
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int patch_finish(patch_state *p)
+{
+	u32 len = p->pos % PATCH_PAGE;
+
+	if (p->state != DONE || p->pos != p->new_size) return 1;
+	if (len == 0) return 0;
+
+	memset(p->out + len, 0xFF, PATCH_PAGE - len);
+	return p->emit(p->out, len);
+}
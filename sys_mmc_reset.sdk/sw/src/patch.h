@@ -0,0 +1,72 @@
+/*
+ * Info   : Streaming decoder of binary patches (delta from a stored file to a new one).
+ *
+ * Patch: HEADER | operations | END
+ *  HEADER: 'P' 'T' 'C' 'H' | SRC_SIZE | SRC_CRC | NEW_SIZE | NEW_CRC, 32 bits each, MSB first
+ *  COPY  : PATCH_OP_COPY | OFFSET(23:0) | LEN(23:0)  copy LEN bytes of the source file from OFFSET
+ *  INSERT: PATCH_OP_INSERT | LEN(15:0) | DATA[LEN]   new bytes
+ *  END   : PATCH_OP_END
+ * The CRCs are the CRC-32 (crc32.c) of the whole source and new files.
+ *
+ * The input can be fed in pieces of any size. The source is read one
+ * PATCH_PAGE byte page at a time through a callback, so a COPY can start and
+ * end anywhere. The output is given out in PATCH_PAGE byte pages.
+ */
+
+#ifndef PATCH_H
+#define PATCH_H
+
+#include <xil_types.h>
+
+#define PATCH_MAGIC     0x50544348 //ASCII for 'PTCH'
+#define PATCH_HDR_LEN   20
+#define PATCH_PAGE      256 //page size of the source reads and of the output, one MMC flash buffer
+
+#define PATCH_OP_END    0x00
+#define PATCH_OP_COPY   0x01
+#define PATCH_OP_INSERT 0x02
+
+/* called for every output page, LEN is PATCH_PAGE but for the last page
+ *  returns: 0 on success, 1 to stop the decoder
+ */
+typedef int (*patch_emit_fn)(u8 *page, u16 len);
+
+/* read the source page at byte offset ADR (a multiple of PATCH_PAGE) into PAGE
+ *  returns: 0 on success, 1 on failure
+ */
+typedef int (*patch_read_fn)(u32 adr, u8 *page);
+
+typedef struct {
+	u8  out[PATCH_PAGE] __attribute__((aligned(4)));
+	u8  src[PATCH_PAGE] __attribute__((aligned(4)));
+	u8  hdr[PATCH_HDR_LEN]; //header, then the arguments of the current operation
+	u32 src_size;
+	u32 src_crc;
+	u32 new_size;
+	u32 new_crc;
+	u32 src_page;  //offset of the page in SRC, 0xFFFFFFFF if none
+	u32 pos;       //output bytes so far
+	u32 offset;    //COPY source offset
+	u32 len;       //bytes left in the current operation
+	u8  state;
+	u8  n;         //bytes in HDR
+	patch_emit_fn emit;
+	patch_read_fn read;
+} patch_state;
+
+void patch_init(patch_state *p, patch_read_fn read, patch_emit_fn emit);
+
+/* decode N more patch bytes
+ *
+ *  returns: 0 on success, 1 on a corrupt patch or if READ or EMIT failed
+ */
+int patch_feed(patch_state *p, const u8 *in, u32 n);
+
+/* end of input: emit the last, partial, page (padded with 0xFF)
+ *
+ *  returns: 0 on success, 1 if the patch is truncated, the output size is not
+ *  NEW_SIZE or EMIT failed
+ */
+int patch_finish(patch_state *p);
+
+#endif // PATCH_H
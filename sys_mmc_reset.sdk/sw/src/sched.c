@@ -0,0 +1,93 @@
+#include "sched.h"
+#include "delay.h"
+
+typedef struct {
+	sched_fn fn;
+	u32 period_us;
+	u32 last_us; //last run
+	u8  flags;
+} sched_task;
+
+static sched_task tasks[SCHED_MAX_TASKS];
+static u8 ntasks    = 0;
+static u8 running   = 0; //a task is running: it may wait for the MMC, the others do not run from there
+static u8 job_on    = 0;
+static u8 cancelled = 0;
+static sched_job job;
+
+int sched_add(sched_fn fn, u32 period_us, u8 flags)
+{
+	if (ntasks == SCHED_MAX_TASKS) return 1;
+
+	tasks[ntasks].fn        = fn;
+	tasks[ntasks].period_us = period_us;
+	tasks[ntasks].last_us   = time_now_us();
+	tasks[ntasks].flags     = flags;
+	ntasks++;
+
+	return 0;
+}
+
+static void run(u8 bus)
+{
+	u32 now;
+	u8  i;
+
+	if (running) return;
+	running = 1;
+
+	for (i = 0; i < ntasks; i++) {
+		if ((tasks[i].flags & SCHED_BUS) && !bus) continue;
+		now = time_now_us();
+		if (tasks[i].period_us && now - tasks[i].last_us < tasks[i].period_us) continue;
+		tasks[i].last_us = now;
+		tasks[i].fn();
+	}
+
+	running = 0;
+}
+
+void sched_run(void)
+{
+	run(!job_on);
+}
+
+void sched_yield(void)
+{
+	run(0);
+}
+
+void sched_job_begin(const char *name, u32 total)
+{
+	job.name  = name;
+	job.total = total;
+	job.done  = 0;
+	job_on    = 1;
+	cancelled = 0;
+}
+
+void sched_job_progress(u32 done)
+{
+	job.done = done;
+}
+
+void sched_job_end(void)
+{
+	job_on    = 0;
+	cancelled = 0;
+}
+
+const sched_job *sched_get_job(void)
+{
+	return job_on ? &job : NULL;
+}
+
+void sched_cancel(void)
+{
+	if (job_on) cancelled = 1;
+}
+
+int sched_cancelled(void)
+{
+	return cancelled;
+}
@@ -0,0 +1,57 @@
+/*
+ * Info   : Cooperative scheduler.
+ *
+ * Tasks are plain functions that run to completion, each one at most every
+ * PERIOD_US. They run from sched_run(), where the application waits for the
+ * console, and from sched_yield(), where a long job waits for the MMC. A task
+ * flagged SCHED_BUS talks to the MMC: it runs only from sched_run() and only
+ * when no job is running, so it never lands between the commands of a job.
+ *
+ * A job (file copy, upload, dump) is announced with sched_job_begin(). It
+ * reports its progress and stops at the first point where it can do so
+ * cleanly once sched_cancelled() is set.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <xil_types.h>
+
+#define SCHED_MAX_TASKS 6
+#define SCHED_BUS       0x01 //the task uses the MMC bus
+
+typedef void (*sched_fn)(void);
+
+/* the running job */
+typedef struct {
+	const char *name; //NULL: no progress report, e.g. the console carries the data
+	u32 total;        //units of work, 0 if not known
+	u32 done;
+} sched_job;
+
+/* add task FN, run at most every PERIOD_US (0: every time)
+ *
+ *  returns: 0 on success, 1 if the task table is full
+ */
+int sched_add(sched_fn fn, u32 period_us, u8 flags);
+
+/* run the tasks that are due, SCHED_BUS ones included when no job is running */
+void sched_run(void);
+
+/* run the tasks that are due, except the SCHED_BUS ones: called by the jobs while they wait */
+void sched_yield(void);
+
+void sched_job_begin(const char *name, u32 total);
+void sched_job_progress(u32 done);
+void sched_job_end(void);
+
+/* returns: the running job, NULL if there is none */
+const sched_job *sched_get_job(void);
+
+/* ask the running job to stop, nothing happens if there is none */
+void sched_cancel(void);
+
+/* returns: 1 if the running job shall stop */
+int sched_cancelled(void);
+
+#endif // SCHED_H
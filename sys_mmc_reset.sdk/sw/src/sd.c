@@ -0,0 +1,250 @@
+#include "sd.h"
+#include <string.h>
+#include "xil_printf.h"
+#include "mmc.h"
+
+#define HALF     MMC_FLASH_BUF_LEN
+#define NO_ADR   0xFFFFFFFF
+
+static sd_stats stats;
+
+static u8  cache[SD_SECTOR_SIZE] __attribute__((aligned(4)));
+static u32 cache_adr   = NO_ADR; //address of the cached sector
+static u16 cache_lo    = 0;      //bytes LO..HI-1 were written by the caller
+static u16 cache_hi    = 0;
+static u8  cache_valid = 0;      //bit N: all of half N is current (read back from the card)
+static u8  cache_dirty = 0;
+static u8  tmp[HALF] __attribute__((aligned(4))); //last half read for a partial read
+static u32 tmp_adr = NO_ADR;
+
+static u8  prog_pending = 0;     //an SDPROG is running
+static u32 ra_adr   = NO_ADR;    //half being read ahead
+static u32 last_adr = NO_ADR;    //last half read from the card
+static u8  ra_on    = 1;
+
+static const mmc_seq seq_sdprog = {MMC_CMD_SDPROG, 1};
+
+/* wait for the running SD command, a read ahead is dropped
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int sd_idle(void)
+{
+	if (ra_adr != NO_ADR) {
+		mmc_wait_cmd_res(MMC_CMD_SDREAD); //the address may be past the end of the card
+		ra_adr = NO_ADR;
+	}
+	if (!prog_pending) return 0;
+	prog_pending = 0;
+
+	if (mmc_wait_cmd_res(MMC_CMD_SDPROG) & 0xFFFF) {
+		xil_printf("sd_write()::ERROR::Could not write SD card\n\r");
+		return 1;
+	}
+	return 0;
+}
+
+/* read the half sector at ADR from the card into BUF
+ *  AHEAD: start reading the next half if the reads are sequential
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int read_half(u32 adr, u8 *buf, u8 ahead)
+{
+	u32 res;
+
+	if (ra_adr == adr) {
+		ra_adr = NO_ADR;
+		res = mmc_wait_cmd_res(MMC_CMD_SDREAD);
+		stats.reads_ahead++;
+	} else {
+		if (sd_idle()) return 1;
+		mmc_set_addr(adr);
+		res = mmc_run_cmd(MMC_CMD_SDREAD);
+	}
+	if (res & 0xFFFF) {
+		xil_printf("sd_read()::ERROR::Could not read SD card address 0x%08X (error 0x%08X)\n\r", adr, res);
+		return 1;
+	}
+	stats.reads++;
+	mmc_get_buffer(buf, HALF);
+
+	if (ahead && ra_on && adr == last_adr + HALF) {
+		mmc_set_addr(adr + HALF);
+		mmc_start_cmd(MMC_CMD_SDREAD);
+		ra_adr = adr + HALF;
+	}
+	last_adr = adr;
+
+	return 0;
+}
+
+/* returns: 1 if all of half H of the cached sector is current */
+static int half_current(u8 h)
+{
+	return (cache_valid & (1 << h)) || (cache_lo <= h * HALF && cache_hi >= (h + 1) * HALF);
+}
+
+/* read half H of the cached sector back from the card, the bytes written by the caller are kept
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int fill_half(u8 h)
+{
+	u16 i;
+
+	if (half_current(h)) return 0;
+	tmp_adr = NO_ADR;
+	if (read_half(cache_adr + h * HALF, tmp, 0)) return 1;
+	for (i = 0; i < HALF; i++) {
+		if (h * HALF + i < cache_lo || h * HALF + i >= cache_hi) cache[h * HALF + i] = tmp[i];
+	}
+	cache_valid |= 1 << h;
+	stats.rmw_reads++;
+
+	return 0;
+}
+
+/* program the cached sector, the halves not fully written are read back first
+ *  The program of the upper half is started but not waited for
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int commit(void)
+{
+	if (!cache_dirty) return 0;
+	if (fill_half(0) || fill_half(1)) return 1;
+
+	/* nothing between the two halves, or the lower one is erased */
+	if (sd_idle()) return 1;
+	mmc_set_buffer(cache, HALF);
+	mmc_chain_begin();
+	mmc_set_addr(cache_adr);
+	mmc_start_seq(&seq_sdprog);
+	mmc_chain_end();
+	if (mmc_wait_cmd_res(MMC_CMD_SDPROG) & 0xFFFF) {
+		xil_printf("sd_write()::ERROR::Could not write SD card address 0x%08X\n\r", cache_adr);
+		return 1;
+	}
+	mmc_set_buffer(cache + HALF, HALF);
+	mmc_chain_begin();
+	mmc_set_addr(cache_adr + HALF);
+	mmc_start_seq(&seq_sdprog);
+	mmc_chain_end();
+	prog_pending = 1;
+	stats.writes += 2;
+	cache_dirty  = 0;
+
+	return 0;
+}
+
+int sd_read(u32 adr, u8 *buf, u32 n)
+{
+	u32 half, off, k;
+	u8  h;
+	u8 *src;
+
+	for (; n; n -= k, adr += k, buf += k) {
+		half = adr & ~(HALF - 1);
+		off  = adr - half;
+		k    = HALF - off;
+		if (k > n) k = n;
+		h    = (half / HALF) & 1;
+
+		/* data written but not programmed yet comes from the cache */
+		if ((half & ~(SD_SECTOR_SIZE - 1)) == cache_adr && cache_dirty &&
+		    (half_current(h) || (cache_lo < (h + 1) * HALF && cache_hi > h * HALF))) {
+			if (fill_half(h)) return 1;
+			src = cache + h * HALF;
+			stats.cache_hits++;
+		} else if (half == tmp_adr) {
+			src = tmp;
+			stats.cache_hits++;
+		} else if (k == HALF) {
+			if (read_half(half, buf, 1)) return 1;
+			continue;
+		} else {
+			if (read_half(half, tmp, 1)) return 1;
+			tmp_adr = half;
+			src = tmp;
+		}
+		memcpy(buf, src + off, k);
+	}
+
+	return 0;
+}
+
+int sd_write(u32 adr, const u8 *buf, u32 n)
+{
+	u32 sec, off, k;
+
+	for (; n; n -= k, adr += k, buf += k) {
+		sec = adr & ~(SD_SECTOR_SIZE - 1);
+		off = adr - sec;
+		k   = SD_SECTOR_SIZE - off;
+		if (k > n) k = n;
+		if ((tmp_adr & ~(SD_SECTOR_SIZE - 1)) == sec) tmp_adr = NO_ADR;
+
+		if (sec != cache_adr || !cache_dirty) {
+			if (commit()) return 1;
+			cache_adr   = sec;
+			cache_valid = 0;
+			cache_lo    = off;
+			cache_hi    = off;
+		}
+
+		/* the written bytes are tracked as one range: a write apart from it needs the rest of the sector first */
+		if (off > cache_hi || off + k < cache_lo) {
+			if (fill_half(0) || fill_half(1)) return 1;
+		} else {
+			if (off < cache_lo) cache_lo = off;
+			if (off + k > cache_hi) cache_hi = off + k;
+		}
+		memcpy(cache + off, buf, k);
+		cache_dirty = 1;
+
+		/* the sector is complete: program it while the caller goes on */
+		if (off + k == SD_SECTOR_SIZE && commit()) return 1;
+	}
+
+	return 0;
+}
+
+int sd_read_sector(u32 sector, u8 *buf)
+{
+	return sd_read(sector * SD_SECTOR_SIZE, buf, SD_SECTOR_SIZE);
+}
+
+int sd_write_sector(u32 sector, const u8 *buf)
+{
+	return sd_write(sector * SD_SECTOR_SIZE, buf, SD_SECTOR_SIZE);
+}
+
+int sd_flush(void)
+{
+	int ret;
+
+	ret = commit();
+	if (sd_idle()) ret = 1;
+	last_adr  = NO_ADR;
+	tmp_adr   = NO_ADR; //the card may be changed by other commands
+	cache_adr = NO_ADR;
+
+	return ret;
+}
+
+/* enable or disable the read ahead of sequential reads */
+void sd_read_ahead(int on)
+{
+	ra_on = on;
+}
+
+sd_stats *sd_get_stats(void)
+{
+	return &stats;
+}
+
+void sd_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
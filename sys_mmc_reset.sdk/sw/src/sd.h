@@ -0,0 +1,63 @@
+/*
+ * Info   : Block device over the MMC's SD card commands.
+ *
+ * SDREAD and SDPROG move half a sector (MMC_FLASH_BUF_LEN bytes). The MMC
+ * writes a whole SD_SECTOR_SIZE sector only if its upper half is programmed
+ * right after its lower half: programmed alone, a half erases the other one.
+ * Writes are therefore assembled in a one sector write-back cache. When the
+ * sector is committed, any half not written by the caller is read back first,
+ * then both halves are programmed one after the other.
+ *
+ * Sequential reads are read ahead by one half: the next SDREAD is started
+ * before sd_read() returns and runs while the caller uses the data.
+ *
+ * An SD command may still be running when these functions return: call
+ * sd_flush() before any other MMC command.
+ */
+
+#ifndef SD_H
+#define SD_H
+
+#include <xil_types.h>
+
+/* counters of the SD block device */
+typedef struct {
+	u32 reads;       //SDREAD commands
+	u32 reads_ahead; //SDREAD started ahead and used
+	u32 rmw_reads;   //halves read back to complete a sector before programming it
+	u32 cache_hits;  //halves read from the sector cache
+	u32 writes;      //SDPROG commands, two per sector
+} sd_stats;
+
+/* read N bytes from the SD card address ADR into BUF
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int sd_read(u32 adr, u8 *buf, u32 n);
+
+/* write N bytes of BUF at the SD card address ADR
+ *  The rest of the sectors is preserved. A sector is programmed as soon as its
+ *  last byte is written, the others are kept in the cache until sd_flush()
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int sd_write(u32 adr, const u8 *buf, u32 n);
+
+/* read or write the whole sector number SECTOR, BUF holds SD_SECTOR_SIZE bytes
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int sd_read_sector(u32 sector, u8 *buf);
+int sd_write_sector(u32 sector, const u8 *buf);
+
+/* program the cached sector, wait for the running SD command and empty the cache
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int sd_flush(void);
+
+void sd_read_ahead(int on);
+sd_stats *sd_get_stats(void);
+void sd_reset_stats(void);
+
+#endif // SD_H
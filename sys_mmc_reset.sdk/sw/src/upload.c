@@ -0,0 +1,279 @@
+#include "upload.h"
+#include <string.h>
+#include "xil_printf.h"
+#include "mmc.h"
+#include "crc32.h"
+#include "lz.h"
+#include "patch.h"
+#include "console.h"
+#include "sched.h"
+
+static upload_stats stats;
+static const mmc_seq seq_ferase = {MMC_CMD_FERASE, 1};
+static const mmc_seq seq_fprog  = {MMC_CMD_FPROG,  1};
+
+/* Receive one frame
+ *  Bytes before the SOF are skipped, so a damaged frame is followed by a resync
+ *
+ *  returns: 0 on success, 1 on a bad frame, 2 if the PC cancelled the transfer
+ */
+static int recv_frame(u8 *seq, u16 *len, u8 *buf)
+{
+	u8  hdr[3], c;
+	u32 crc = 0;
+	u16 i;
+
+	do {
+		c = console_getc();
+		if (c == UPLOAD_CAN) return 2;
+	} while (c != UPLOAD_SOF);
+
+	for (i = 0; i < 3; i++) hdr[i] = console_getc();
+	*seq = hdr[0];
+	*len = buf8_to_16((hdr+1));
+	if (*len > UPLOAD_MAX_LEN) return 1;
+
+	for (i = 0; i < *len; i++) buf[i] = console_getc();
+	for (i = 0; i < 4; i++) crc = (crc << 8) | (u8)console_getc();
+
+	return (crc == crc32_update(crc32_update(0, hdr, 3), buf, *len)) ? 0 : 1;
+}
+
+static void answer(u8 code, u8 seq)
+{
+	outbyte(code);
+	outbyte(seq);
+}
+
+static u32 file_adr;     //flash address of the file
+static u8  src_id;       //source file of a patch
+static u8  src_checked;  //the source file matches the patch header
+static u8  pending = 0;  //a page program is running
+
+/* wait for the page program started by the previous page
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int prog_wait(void)
+{
+	if (!pending) return 0;
+	pending = 0;
+
+	return (mmc_wait_cmd_res(MMC_CMD_FPROG) & 0xFFFF) ? 1 : 0;
+}
+
+/* append LEN file bytes from PAGE (LEN is 256 but for the last page) to the file
+ *  The program of the page is started but not waited for
+ *  PAGE: 256 byte buffer, 4 bytes aligned, the bytes after LEN are overwritten
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int page_out(u8 *page, u16 len)
+{
+	u32 adr = file_adr + stats.bytes;
+
+	if (stats.bytes + len > FLASH_FILE_SIZE) return 1;
+	stats.crc = crc32_update(stats.crc, page, len);
+
+	if (prog_wait()) return 1;
+	if (adr % FLASH_SECTOR_SIZE == 0) {
+		mmc_chain_begin();
+		mmc_set_addr(adr);
+		mmc_start_seq(&seq_ferase);
+		mmc_chain_end();
+		if (mmc_wait_cmd_res(MMC_CMD_FERASE) & 0xFFFF) return 1;
+	}
+	if (len < UPLOAD_MAX_LEN) memset(page + len, 0xFF, UPLOAD_MAX_LEN - len);
+	if (!mmc_page_blank(page)) {
+		mmc_set_buffer(page, UPLOAD_MAX_LEN);
+		mmc_chain_begin();
+		mmc_set_addr(adr);
+		mmc_start_seq(&seq_fprog);
+		mmc_chain_end();
+		pending = 1;
+	}
+	stats.bytes += len;
+
+	return 0;
+}
+
+/* decoders of upload(), only one is used at a time (BRAM, next to the stack and the heap) */
+static union {
+	lz_state    lz;
+	patch_state patch;
+} dec;
+
+/* read one page of the source file of a patch
+ *  The first time, the source file is checked against the patch header: size
+ *  and CRC stored in its info sector, nothing is written to the flash
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int src_read(u32 adr, u8 *page)
+{
+	const mmc_file_meta *m;
+
+	if (prog_wait()) return 1;
+	if (!src_checked) {
+		m = mmc_file_meta_get(src_id);
+		if (!m) return 1;
+		if (m->size != dec.patch.src_size || m->crc != dec.patch.src_crc) {
+			xil_printf("\n\rupload_file()::ERROR::Source file is %d bytes with CRC 0x%08X, the patch is for %d bytes with CRC 0x%08X\n\r",
+				m->size, m->crc, dec.patch.src_size, dec.patch.src_crc);
+			return 1;
+		}
+		src_checked = 1;
+	}
+
+	mmc_set_addr(src_id * FLASH_FILE_SIZE + adr);
+	if (mmc_run_cmd(MMC_CMD_FREAD) & 0xFFFF) return 1;
+	mmc_get_buffer(page, PATCH_PAGE);
+
+	return 0;
+}
+
+/* pass the data of one frame to the decoder selected by FLAGS
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int feed(u8 flags, u8 *buf, u16 len)
+{
+	if (flags & UPLOAD_LZ)    return lz_feed(&dec.lz, buf, len);
+	if (flags & UPLOAD_PATCH) return patch_feed(&dec.patch, buf, len);
+
+	return page_out(buf, len);
+}
+
+/* end of the data: flush the decoder selected by FLAGS
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int finish(u8 flags)
+{
+	if (flags & UPLOAD_LZ) return lz_finish(&dec.lz);
+	if (flags & UPLOAD_PATCH) {
+		if (patch_finish(&dec.patch)) return 1;
+		if (stats.crc != dec.patch.new_crc) {
+			xil_printf("\n\rupload_file()::ERROR::Patched file CRC is 0x%08X instead of 0x%08X\n\r", stats.crc, dec.patch.new_crc);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* receive a file as described in upload_file(), FLAGS selects the decoder
+ *
+ * returns: 0 on success, 1 on failure
+ */
+static int upload(u8 id, u8 flags)
+{
+	static u8 buf[UPLOAD_MAX_LEN] __attribute__((aligned(4))); //aligned for mmc_page_blank(), not on the 1KiB stack
+	u8  seq, expected = 0, nak_sent = 0, last = 0;
+	u16 len;
+	int r;
+
+	memset(&stats, 0, sizeof(stats));
+	file_adr = id * FLASH_FILE_SIZE;
+	pending  = 0;
+
+	/* no console output from here until the end of the transfer */
+	answer(UPLOAD_NAK, 0);
+	for (;;) {
+		r = recv_frame(&seq, &len, buf);
+		if (r == 2) break;
+		if (r || seq != expected) {
+			/* ask once for a go-back to EXPECTED, the frames already in flight are dropped */
+			stats.errors++;
+			if (!nak_sent) answer(UPLOAD_NAK, expected);
+			nak_sent = 1;
+			continue;
+		}
+		nak_sent = 0;
+		if (len == 0) break; //end of file
+
+		if (last) {
+			r = 2; //short frame before the end
+			break;
+		}
+		last = (len < UPLOAD_MAX_LEN) && !(flags & (UPLOAD_LZ | UPLOAD_PATCH));
+
+		/* accept the frame: the PC sends the next ones while this one goes to the MMC */
+		answer(UPLOAD_ACK, seq);
+		expected++;
+		stats.frames++;
+		stats.rx_bytes += len;
+
+		if (feed(flags, buf, len)) {
+			r = 2;
+			break;
+		}
+	}
+
+	if (r != 2 && finish(flags)) r = 2;
+	if (prog_wait()) r = 2;
+	if (r == 2) {
+		outbyte(UPLOAD_CAN);
+		xil_printf("\n\rupload_file()::ERROR::Transfer aborted after %d bytes\n\r", stats.bytes);
+		return 1;
+	}
+
+	/* end of file: length and CRC, then the end frame is acknowledged */
+	xil_printf("\n\rupload_file()::INFO::Received %d bytes in %d frames (%d rejected), file size %d, CRC = 0x%08X\n\r",
+		stats.rx_bytes, stats.frames, stats.errors, stats.bytes, stats.crc);
+	if (mmc_flash_file_info(id, stats.bytes, stats.crc)) {
+		outbyte(UPLOAD_CAN);
+		return 1;
+	}
+	answer(UPLOAD_ACK, seq);
+
+	return 0;
+}
+
+/* run the transfer as a job, the console carries binary data meanwhile */
+static int upload_job(u8 id, u8 flags)
+{
+	int ret;
+
+	console_raw(1);
+	sched_job_begin(NULL, 0);
+	ret = upload(id, flags);
+	console_flush(); //the last answer reaches the PC before the menu talks again
+	sched_job_end();
+	console_raw(0);
+
+	return ret;
+}
+
+int upload_file(u8 id, u8 flags)
+{
+	if (id > 14) {
+		xil_printf("upload_file()::ERROR::Maximum allowed ID is 14\n\r");
+		return 1;
+	}
+	if (flags & UPLOAD_LZ) {
+		lz_init(&dec.lz, page_out);
+		xil_printf("upload_file()::INFO::Decompressor uses %d bytes (%d bytes window)\n\r", (int)sizeof(dec.lz), LZ_WINDOW);
+	}
+
+	return upload_job(id, flags & UPLOAD_LZ);
+}
+
+int upload_patch(u8 src, u8 dst)
+{
+	if (src > 14 || dst > 14 || src == dst) {
+		xil_printf("upload_patch()::ERROR::Source and destination shall be different IDs, up to 14\n\r");
+		return 1;
+	}
+	src_id      = src;
+	src_checked = 0;
+	patch_init(&dec.patch, src_read, page_out);
+	xil_printf("upload_patch()::INFO::Patch decoder uses %d bytes\n\r", (int)sizeof(dec.patch));
+
+	return upload_job(dst, UPLOAD_PATCH);
+}
+
+upload_stats *upload_get_stats(void)
+{
+	return &stats;
+}
@@ -0,0 +1,67 @@
+/*
+ * Info   : Binary upload of a file into MMC flash over the mdm_1 console.
+ *
+ * Frame sent by the PC:  SOF | SEQ | LEN(15:8) | LEN(7:0) | DATA[LEN] | CRC(31:24) .. CRC(7:0)
+ *  SEQ is the frame number modulo 256, LEN is at most 256 (one flash page),
+ *  only the last data frame can be shorter and a frame with LEN = 0 ends the
+ *  file. CRC is the CRC-32 (crc32.c) of SEQ, LEN and DATA.
+ * Answers of the target: ACK | SEQ when frame SEQ is accepted,
+ *  NAK | SEQ to ask for a retransmission starting from frame SEQ, CAN to abort.
+ *
+ * The target sends NAK 0 when it is ready. The PC can send up to
+ * UPLOAD_WINDOW frames ahead of the last acknowledged one (go-back-N on NAK).
+ * A frame is acknowledged as soon as its CRC is checked, then it is written to
+ * the MMC while the next one is being received.
+ * With UPLOAD_LZ the frames carry an LZ4-style stream (lz.h) that is
+ * decompressed on the fly, the pages are programmed as they come out.
+ * upload_patch() takes a binary patch (patch.h) instead, the new file is
+ * rebuilt from pages of a source file and programmed in the same way.
+ * Text lines can be printed before the final answer, the PC shall skip any
+ * byte that is not one of the answer codes.
+ */
+
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include <xil_types.h>
+
+#define UPLOAD_SOF     0xA5
+#define UPLOAD_ACK     0x06
+#define UPLOAD_NAK     0x15
+#define UPLOAD_CAN     0x18
+#define UPLOAD_WINDOW  4   //frames the PC may send without acknowledgement
+#define UPLOAD_MAX_LEN 256 //data bytes per frame
+
+/* upload_file() flags */
+#define UPLOAD_LZ    0x01 //the frames carry compressed data
+#define UPLOAD_PATCH 0x02 //the frames carry a patch, used by upload_patch()
+
+typedef struct {
+	u32 frames;  //accepted data frames
+	u32 errors;  //frames rejected because of CRC, length or sequence errors
+	u32 rx_bytes;//data bytes received
+	u32 bytes;   //file bytes written
+	u32 crc;     //CRC-32 of the file
+} upload_stats;
+
+/* Receive a file from the console and program it as file ID (0..14)
+ *  The file section is erased sector by sector as the data arrives, the
+ *  file length is written and the CRC computed by the MMC is checked at the end.
+ *  FLAGS: UPLOAD_LZ if the data is compressed
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int upload_file(u8 id, u8 flags);
+
+/* Receive a patch from the console and program file SRC with the patch applied as file DST
+ *  SRC is checked against the size and CRC in the patch header before it is used,
+ *  and the result against the new size and CRC, then as in upload_file().
+ *  Typically SRC is the firmware slot in use (0 or 1) and DST the other one.
+ *
+ *  returns: 0 on success, 1 on failure
+ */
+int upload_patch(u8 src, u8 dst);
+
+upload_stats *upload_get_stats(void);
+
+#endif // UPLOAD_H